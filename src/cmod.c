@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 1997-2009, Michael Jennings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of the Software, its documentation and marketing & publicity
+ * materials, and acknowledgment shall be given in the documentation, materials
+ * and software packages that this Software was used.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+static const char cvs_ident[] = "$Id$";
+
+#include "config.h"
+
+#include <X11/Xlib.h>
+#include <Imlib2.h>
+
+#include "cmod.h"
+
+/* New optimized routines for tinting XImages written by Willem Monsuwe <willem@stack.nl>.
+   These are the reference the mmx, sse2, and avx2 versions have to match; see cmod_check.c. */
+
+/* RGB 15 */
+void
+shade_ximage_15(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    unsigned char *ptr;
+    int x, y;
+
+    ptr = (unsigned char *) data + (w * sizeof(DATA16));
+    if (!COLORMODS_HAVE_SATURATION(rm, gm, bm)) {
+        /* No saturation */
+        for (y = h; --y >= 0;) {
+            for (x = -w; x < 0; x++) {
+                int r, g, b;
+
+                b = ((DATA16 *) ptr)[x];
+                r = (b & 0x7c00) * rm;
+                g = (b & 0x3e0) * gm;
+                b = (b & 0x1f) * bm;
+                ((DATA16 *) ptr)[x] = ((r >> 8) & 0x7c00)
+                    | ((g >> 8) & 0x3e0)
+                    | ((b >> 8) & 0x1f);
+            }
+            ptr += bpl;
+        }
+    } else {
+        for (y = h; --y >= 0;) {
+            for (x = -w; x < 0; x++) {
+                int r, g, b;
+
+                b = ((DATA16 *) ptr)[x];
+                r = (((b >> 10) & 0x001f ) * rm) >> 8;
+                r = (r > 0x001f) ? 0x7c00 : (r << 10);
+                g = (((b >>  5) & 0x001f ) * gm) >> 8;
+                g = (g > 0x001f) ? 0x03e0 : (g << 5);
+                b = (((b >>  0) & 0x001f ) * bm) >> 8;
+                b = (b > 0x001f) ? 0x001f : (b << 0);
+                ((DATA16 *) ptr)[x] = (r|g|b);
+            }
+            ptr += bpl;
+        }
+    }
+}
+
+/* RGB 16 */
+void
+shade_ximage_16(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    unsigned char *ptr;
+    int x, y;
+
+    ptr = (unsigned char *) data + (w * sizeof(DATA16));
+    if (!COLORMODS_HAVE_SATURATION(rm, gm, bm)) {
+        /* No saturation */
+        for (y = h; --y >= 0;) {
+            for (x = -w; x < 0; x++) {
+                int r, g, b;
+
+                b = ((DATA16 *) ptr)[x];
+                r = (b & 0xf800) * rm;
+                g = (b & 0x7e0) * gm;
+                b = (b & 0x1f) * bm;
+                ((DATA16 *) ptr)[x] = ((r >> 8) & 0xf800)
+                    | ((g >> 8) & 0x7e0)
+                    | ((b >> 8) & 0x1f);
+            }
+            ptr += bpl;
+        }
+    } else {
+        for (y = h; --y >= 0;) {
+            for (x = -w; x < 0; x++) {
+                int r, g, b;
+
+                b = ((DATA16 *) ptr)[x];
+                r = (((b >> 11) & 0x001f) * rm) >> 8;
+		r = (r > 0x001f) ? 0xf800 : (r << 11);
+                g = (((b >>  5) & 0x003f) * gm) >> 8;
+		g = (g > 0x003f) ? 0x07e0 : (g << 5);
+                b = (((b >>  0) & 0x001f) * bm) >> 8;
+		b = (b > 0x001f) ? 0x001f : (b << 0);
+                ((DATA16 *) ptr)[x] = (r|g|b);
+            }
+            ptr += bpl;
+        }
+    }
+}
+
+/* RGB 32 */
+void
+shade_ximage_32(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    unsigned char *ptr;
+    int x, y;
+
+    ptr = (unsigned char *) data + (w * 4);
+    if (!COLORMODS_HAVE_SATURATION(rm, gm, bm)) {
+        /* No saturation */
+        for (y = h; --y >= 0;) {
+            for (x = -(w * 4); x < 0; x += 4) {
+# if WORDS_BIGENDIAN
+                ptr[x + 1] = ((ptr[x + 1] * rm) >> 8);
+                ptr[x + 2] = ((ptr[x + 2] * gm) >> 8);
+                ptr[x + 3] = ((ptr[x + 3] * bm) >> 8);
+# else
+                ptr[x + 2] = ((ptr[x + 2] * rm) >> 8);
+                ptr[x + 1] = ((ptr[x + 1] * gm) >> 8);
+                ptr[x + 0] = ((ptr[x + 0] * bm) >> 8);
+# endif
+            }
+            ptr += bpl;
+        }
+    } else {
+        for (y = h; --y >= 0;) {
+            for (x = -(w * 4); x < 0; x += 4) {
+                int r, g, b;
+# if WORDS_BIGENDIAN
+                r = (ptr[x + 1] * rm) >> 8;
+                ptr[x + 1] = r|(!(r >> 8) - 1);
+                g = (ptr[x + 2] * gm) >> 8;
+                ptr[x + 2] = g|(!(g >> 8) - 1);
+                b = (ptr[x + 3] * bm) >> 8;
+                ptr[x + 3] = b|(!(b >> 8) - 1);
+# else
+                r = (ptr[x + 2] * rm) >> 8;
+                ptr[x + 2] = r|(!(r >> 8) - 1);
+                g = (ptr[x + 1] * gm) >> 8;
+                ptr[x + 1] = g|(!(g >> 8) - 1);
+                b = (ptr[x + 0] * bm) >> 8;
+                ptr[x + 0] = b|(!(b >> 8) - 1);
+# endif
+            }
+            ptr += bpl;
+        }
+    }
+}
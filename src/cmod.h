@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 1997-2009, Michael Jennings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of the Software, its documentation and marketing & publicity
+ * materials, and acknowledgment shall be given in the documentation, materials
+ * and software packages that this Software was used.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _CMOD_H_
+#define _CMOD_H_
+
+/* FIXME:  Workaround for older versions of libast. */
+#ifndef WORDS_BIGENDIAN
+#  define WORDS_BIGENDIAN 0
+#endif
+
+/* Optimized check for rm, gm, and bm all < 256 */
+#define COLORMODS_HAVE_SATURATION(rm, gm, bm)  ((rm|gm|bm) >> 8)
+
+/* C routines (cmod.c) */
+extern void shade_ximage_15(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_16(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_32(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+
+/* Assembler routines for 32 bit cpu with mmx */
+extern void shade_ximage_15_mmx(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_16_mmx(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_32_mmx(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+
+/* Assembler routines for 64 bit cpu with sse2, or intrinsics (simd_cmod.c) with HAVE_CPU_DISPATCH */
+extern void shade_ximage_15_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_16_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_32_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+
+/* Intrinsics routines for cpus with avx2 (simd_cmod.c) */
+extern void shade_ximage_15_avx2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_16_avx2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+extern void shade_ximage_32_avx2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
+
+#endif /* _CMOD_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 1997-2009, Michael Jennings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of the Software, its documentation and marketing & publicity
+ * materials, and acknowledgment shall be given in the documentation, materials
+ * and software packages that this Software was used.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that the SSE2 and AVX2 color modifiers in simd_cmod.c give exactly
+ * what the C ones in cmod.c do, and times all three on a full-screen image.
+ * Run by "make check"; exits 77 (skipped) when runtime dispatch isn't built.
+ *
+ *   cmod_check [iterations]
+ */
+
+static const char cvs_ident[] = "$Id$";
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cmod.h"
+
+#ifdef HAVE_CPU_DISPATCH
+
+typedef void (*shade_func_t) (void *, int, int, int, int, int, int);
+
+#define CHECK_ITERATIONS  20000
+#define CHECK_MAX_WIDTH   70
+#define CHECK_MAX_HEIGHT  4
+#define BENCH_WIDTH       1920
+#define BENCH_HEIGHT      1080
+#define BENCH_ROUNDS      50
+
+static struct {
+    const char *name;
+    int bytes;
+    shade_func_t c, sse2, avx2;
+} depths[] = {
+    { "15", 2, shade_ximage_15, shade_ximage_15_sse2, shade_ximage_15_avx2 },
+    { "16", 2, shade_ximage_16, shade_ximage_16_sse2, shade_ximage_16_avx2 },
+    { "32", 4, shade_ximage_32, shade_ximage_32_sse2, shade_ximage_32_avx2 }
+};
+
+/* Modifiers around the edges:  no change, saturation starting, and the extremes. */
+static const int edge_mods[] = { 0, 1, 127, 255, 256, 257, 300, 511, 1000, 4095, 32767, 32768, 40000, 65534, 65535 };
+
+static int
+random_mod(int limit)
+{
+    if (rand() & 1) {
+        return edge_mods[rand() % (sizeof(edge_mods) / sizeof(edge_mods[0]))];
+    }
+    return (rand() % limit);
+}
+
+/* Run one random image through all three versions.  Returns 0 on a mismatch. */
+static int
+check_one(int d, int have_avx2)
+{
+    unsigned char *ref, *sse2, *avx2;
+    int w, h, bpl, rm, gm, bm, size, i, ok = 1;
+
+    w = 1 + rand() % CHECK_MAX_WIDTH;
+    h = 1 + rand() % CHECK_MAX_HEIGHT;
+    bpl = w * depths[d].bytes + (rand() % 3) * 4;      /* odd strides too */
+    rm = random_mod(65536);
+    gm = random_mod(256);
+    bm = random_mod(65536);
+    if (!(rand() % 4)) {
+        /* No saturation */
+        rm &= 0xff;
+        gm &= 0xff;
+        bm &= 0xff;
+    }
+
+    size = bpl * h;
+    ref = (unsigned char *) malloc(size);
+    sse2 = (unsigned char *) malloc(size);
+    avx2 = (unsigned char *) malloc(size);
+    for (i = 0; i < size; i++) {
+        ref[i] = rand();
+    }
+    memcpy(sse2, ref, size);
+    memcpy(avx2, ref, size);
+
+    depths[d].c(ref, bpl, w, h, rm, gm, bm);
+    depths[d].sse2(sse2, bpl, w, h, rm, gm, bm);
+    if (memcmp(ref, sse2, size)) {
+        printf("MISMATCH:  %s-bit SSE2, %dx%d, bpl %d, rm %d, gm %d, bm %d\n", depths[d].name, w, h, bpl, rm, gm, bm);
+        ok = 0;
+    }
+    if (have_avx2) {
+        depths[d].avx2(avx2, bpl, w, h, rm, gm, bm);
+        if (memcmp(ref, avx2, size)) {
+            printf("MISMATCH:  %s-bit AVX2, %dx%d, bpl %d, rm %d, gm %d, bm %d\n", depths[d].name, w, h, bpl, rm, gm, bm);
+            ok = 0;
+        }
+    }
+    free(ref);
+    free(sse2);
+    free(avx2);
+    return ok;
+}
+
+static void
+bench(const char *name, shade_func_t func, int bytes, unsigned char *data)
+{
+    clock_t start;
+    int i;
+
+    start = clock();
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        func(data, BENCH_WIDTH * bytes, BENCH_WIDTH, BENCH_HEIGHT, 200, 300, 100);
+    }
+    printf("  %-5s %7.2f ms/frame\n", name, (clock() - start) * 1000.0 / CLOCKS_PER_SEC / BENCH_ROUNDS);
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned char *data;
+    int have_avx2, iterations, failed = 0, i, d;
+
+    iterations = ((argc > 1) ? atoi(argv[1]) : CHECK_ITERATIONS);
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) {
+        printf("No SSE2 on this cpu; nothing to check.\n");
+        return 77;
+    }
+    have_avx2 = __builtin_cpu_supports("avx2");
+    if (!have_avx2) {
+        printf("No AVX2 on this cpu; checking SSE2 only.\n");
+    }
+
+    srand(1);
+    for (i = 0; i < iterations; i++) {
+        if (!check_one(i % 3, have_avx2)) {
+            failed++;
+        }
+    }
+    printf("%d of %d images differ from the C routines.\n", failed, iterations);
+
+    data = (unsigned char *) malloc(BENCH_WIDTH * BENCH_HEIGHT * 4);
+    for (i = 0; i < BENCH_WIDTH * BENCH_HEIGHT * 4; i++) {
+        data[i] = rand();
+    }
+    for (d = 0; d < 3; d++) {
+        printf("%s-bit, %dx%d:\n", depths[d].name, BENCH_WIDTH, BENCH_HEIGHT);
+        bench("C", depths[d].c, depths[d].bytes, data);
+        bench("SSE2", depths[d].sse2, depths[d].bytes, data);
+        if (have_avx2) {
+            bench("AVX2", depths[d].avx2, depths[d].bytes, data);
+        }
+    }
+    free(data);
+    return (failed ? 1 : 0);
+}
+
+#else
+
+int
+main(void)
+{
+    printf("Built without runtime SSE2/AVX2 dispatch; nothing to check.\n");
+    return 77;
+}
+
+#endif
@@ -97,6 +97,9 @@ static const char cvs_ident[] = "$Id$";
 #if defined(linux)
 # include <linux/tty.h>         /* For N_TTY_BUF_SIZE. */
 #endif
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 #ifdef MULTI_CHARSET
 # include <locale.h>
 # include <langinfo.h>
@@ -110,6 +113,7 @@ static const char cvs_ident[] = "$Id$";
 #include "events.h"
 #include "font.h"
 #include "grkelot.h"
+#include "loop.h"
 #include "options.h"
 #include "pixmap.h"
 #ifdef PROFILE
@@ -119,6 +123,7 @@ static const char cvs_ident[] = "$Id$";
 #include "scrollbar.h"
 #include "string.h"
 #include "term.h"
+#include "timer.h"
 #ifdef UTMP_SUPPORT
 # include "eterm_utmp.h"
 #endif
@@ -147,18 +152,26 @@ int cmd_fd = -1;                /* file descriptor connected to the command */
 int pipe_fd = -1;
 pid_t cmd_pid = -1;             /* process id if child */
 int Xfd = -1;                   /* file descriptor of X server connection */
-unsigned int num_fds = 0;       /* number of file descriptors being used */
 struct stat ttyfd_stat;         /* original status of the tty we will use */
-int refresh_count = 0, refresh_limit = 1, refresh_type = FAST_REFRESH;
-unsigned char cmdbuf_base[CMD_BUF_SIZE], *cmdbuf_ptr, *cmdbuf_endp;
-
-/* Addresses pasting large amounts of data
- * code pinched from xterm
+int refresh_count = 0, refresh_type = FAST_REFRESH;
+unsigned long frames_drawn = 0, frame_bytes = 0;  /* screen updates so far, bytes read since the last */
+unsigned char *cmdbuf_base, *cmdbuf_ptr, *cmdbuf_endp;
+unsigned long cmdbuf_size;      /* grows from CMD_BUF_SIZE to CMD_BUF_MAX while output keeps filling it */
+
+/* Everything on its way to the pty -- keystrokes, pastes, replies to query sequences -- is
+ * queued in this ring.  It doubles whenever it fills and is drained by the main loop whenever
+ * cmd_fd will take more, so a large paste streams out behind the user's typing instead of
+ * holding up input processing.
  */
-static char *v_buffer;          /* pointer to physical buffer */
-static char *v_bufstr = NULL;   /* beginning of area to write */
-static char *v_bufptr;          /* end of area to write */
-static char *v_bufend;          /* end of physical buffer */
+#define V_BUF_MIN    4096       /* first allocation */
+#define V_BUF_KEEP   65536      /* keep a ring this big around once it's drained */
+static char *v_buffer = NULL;   /* the ring itself; v_size is always a power of two */
+static unsigned long v_size = 0;
+static unsigned long v_head = 0;        /* offset of the next byte to write */
+static unsigned long v_len = 0; /* bytes queued */
+
+static void v_append(const char *, unsigned long, unsigned char);
+static void v_drain(int);
 
 #ifdef USE_XIM
 XIM xim_input_method = NULL;
@@ -1311,6 +1324,18 @@ clean_exit(void)
     DPRINTF1(("Cleanup done.  I am outta here!\n"));
 }
 
+/* Exit from the main loop, where the display is still usable, letting go of the shaded desktop
+   pixmaps shared with other Eterms first.  Signal handlers and X I/O errors just exit(), and
+   leave the shared list to shade_cache_lock() to tidy up. */
+void
+normal_exit(int status)
+{
+#ifdef PIXMAP_OFFSET
+    free_desktop_pixmap();
+#endif
+    exit(status);
+}
+
 /* Acquire a pseudo-teletype from the system. */
 /*
  * On failure, returns -1.
@@ -2256,7 +2281,6 @@ run_command(char **argv)
     ptyfd = get_pty();
     if (ptyfd < 0)
         return (-1);
-    AT_LEAST(num_fds, ((unsigned int) (ptyfd + 1)));
 
     /* store original tty status for restoration clean_exit() -- rgg 04/12/95 */
     lstat(ttydev, &ttyfd_stat);
@@ -2739,22 +2763,27 @@ exe_prg(void *xd, char **argv)
 
 #define DIRECT_MASK (~(RS_Cursor|RS_Select|RS_fontMask))
 #define COLOUR_MASK (RS_fgMask|RS_bgMask)
-#define DIRECT_SET_SCREEN(x,y,fg,bg) (screen.text[ys+y])[x]=fg; (screen.rend[ys+y])[x]=bg&DIRECT_MASK;
+#define DIRECT_SET_SCREEN(x,y,fg,bg) (SCREEN_TEXT(ys+y))[x]=fg; (SCREEN_REND(ys+y))[x]=bg&DIRECT_MASK;
 #define CLEAR (RS_None | bgColor)
 
 static void
 direct_write_screen(int x, int y, char *fg, rend_t bg)
 {
     int ys = TermWin.saveLines - TermWin.view_start;
-    text_t *t = screen.text[ys + y];
-    rend_t *r = screen.rend[ys + y];
+    text_t *t;
+    rend_t *r;
 
     REQUIRE(fg);
 
+    scr_thaw_rows(ys + y, ys + y);
+    t = SCREEN_TEXT(ys + y);
+    r = SCREEN_REND(ys + y);
+
     while (*fg && (x >= 0) && (x < TERM_WINDOW_GET_REPORTED_COLS())) {
         t[x] = *(fg++);
         r[x++] = bg & DIRECT_MASK;
     }
+    scr_rend_changed(ys + y, ys + y);
 }
 
 #ifdef ESCREEN_FX
@@ -2764,16 +2793,18 @@ bosconian(int n)
     int x, y;
     int ys = TermWin.saveLines - TermWin.view_start;
 
+    scr_thaw_rows(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
     for (; n != 0; n--) {
         for (y = 0; y < TERM_WINDOW_GET_ROWS(); y++) {
-            text_t *t = screen.text[ys + y];
-            rend_t *r = screen.rend[ys + y];
+            text_t *t = SCREEN_TEXT(ys + y);
+            rend_t *r = SCREEN_REND(ys + y);
 
             for (x = 0; x < TERM_WINDOW_GET_COLS(); x++) {
                 t[x] = random() & 0xff;
                 r[x] = random() & COLOUR_MASK;
             }
         }
+        scr_rend_changed(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
         scr_refresh(FAST_REFRESH);
     }
 }
@@ -2785,10 +2816,11 @@ unbosconian(void)
     int ys = TermWin.saveLines - TermWin.view_start;
     rend_t bg;
 
+    scr_thaw_rows(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
     do {
         bg = CLEAR;
         for (y = 0; (bg == CLEAR) && y < TERM_WINDOW_GET_ROWS(); y++) {
-            rend_t *r = screen.rend[ys + y];
+            rend_t *r = SCREEN_REND(ys + y);
 
             for (x = 0; (bg == CLEAR) && x < TERM_WINDOW_GET_COLS(); x++) {
                 if (r[x] != CLEAR) {
@@ -2798,8 +2830,8 @@ unbosconian(void)
         }
         if (bg != CLEAR) {
             for (y = 0; y < TERM_WINDOW_GET_ROWS(); y++) {
-                text_t *t = screen.text[ys + y];
-                rend_t *r = screen.rend[ys + y];
+                text_t *t = SCREEN_TEXT(ys + y);
+                rend_t *r = SCREEN_REND(ys + y);
 
                 for (x = 0; x < TERM_WINDOW_GET_COLS(); x++) {
                     if (r[x] == bg) {
@@ -2808,6 +2840,7 @@ unbosconian(void)
                     }
                 }
             }
+            scr_rend_changed(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
             scr_refresh(FAST_REFRESH);
         }
     } while (bg != CLEAR);
@@ -2832,6 +2865,7 @@ matrix(int n)
     }
 
     memset(s, 0, TERM_WINDOW_GET_COLS());
+    scr_thaw_rows(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
 #define MATRIX_HI CLEAR
 #define MATRIX_LO ((4<<8)|CLEAR)
 
@@ -2843,16 +2877,16 @@ matrix(int n)
                 } else {
                     w = 0;
                 }
-                t = screen.text[ys + y];
-                r = screen.rend[ys + y];
+                t = SCREEN_TEXT(ys + y);
+                r = SCREEN_REND(ys + y);
 
                 switch (w) {
                     case 0:    /* restart */
                         if (s[x]) {
                             r[x] = MATRIX_LO;
                             s[x] = 0;
-                            t = screen.text[ys];
-                            r = screen.rend[ys];
+                            t = SCREEN_TEXT(ys);
+                            r = SCREEN_REND(ys);
                         }
                         r[x] = MATRIX_HI;
                         t[x] = random() & 0xff;
@@ -2864,8 +2898,8 @@ matrix(int n)
                     case 3:
                         for (f = random() & 7; f != 0; f--) {
                             if (y < TERM_WINDOW_GET_ROWS() - 1) {
-                                t2 = screen.text[ys + y + 1];
-                                r2 = screen.rend[ys + y + 1];
+                                t2 = SCREEN_TEXT(ys + y + 1);
+                                r2 = SCREEN_REND(ys + y + 1);
                                 t2[x] = t[x];
                                 r2[x] = r[x];
                                 s[x]++;
@@ -2877,9 +2911,10 @@ matrix(int n)
                             r[x] = MATRIX_LO;
                             t[x] = random() & 0xff;
                             if (f) {
+                                scr_rend_changed(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
                                 scr_refresh(FAST_REFRESH);
-                                t = screen.text[ys + y];
-                                r = screen.rend[ys + y];
+                                t = SCREEN_TEXT(ys + y);
+                                r = SCREEN_REND(ys + y);
                             }
                         }
                         break;
@@ -2889,6 +2924,7 @@ matrix(int n)
                 }
             }
         }
+        scr_rend_changed(ys, ys + TERM_WINDOW_GET_ROWS() - 1);
         scr_refresh(FAST_REFRESH);
     }
     FREE(s);
@@ -3170,11 +3206,8 @@ init_command(char **argv)
 
     Xfd = XConnectionNumber(Xdisplay);
     D_CMD(("Xfd = %d\n", Xfd));
-    cmdbuf_ptr = cmdbuf_endp = cmdbuf_base;
-    AT_LEAST(num_fds, ((unsigned int) (Xfd + 1)));
-    if (pipe_fd >= 0) {
-        AT_LEAST(num_fds, ((unsigned int) (pipe_fd + 1)));
-    }
+    cmdbuf_size = CMD_BUF_SIZE;
+    cmdbuf_ptr = cmdbuf_endp = cmdbuf_base = (unsigned char *) MALLOC(cmdbuf_size);
     if ((cmd_fd = command_func(argv)) < 0) {
         libast_print_error("Unable to run sub-command.\n");
         paused = 1;
@@ -3213,43 +3246,36 @@ tt_resize(void)
     tt_winsize(cmd_fd);
 }
 
+/* Resize the command buffer to <size> bytes, keeping whatever is still unread. */
+static void
+cmdbuf_resize(unsigned long size)
+{
+    unsigned long ptr = cmdbuf_ptr - cmdbuf_base, endp = cmdbuf_endp - cmdbuf_base;
+
+    D_CMD(("Command buffer resized from %lu to %lu bytes.\n", cmdbuf_size, size));
+    cmdbuf_base = (unsigned char *) REALLOC(cmdbuf_base, size);
+    cmdbuf_size = size;
+    cmdbuf_ptr = cmdbuf_base + ptr;
+    cmdbuf_endp = cmdbuf_base + endp;
+}
+
 /* attempt to `write' COUNT to the input buffer */
 unsigned int
 cmd_write(const unsigned char *str, unsigned int count)
 {
+    unsigned long len = cmdbuf_endp - cmdbuf_ptr;
 
-    int n;
-
-    n = (count - (cmdbuf_ptr - cmdbuf_base));
-    /* need to insert more chars that space available in the front */
-    if (n > 0) {
-        /* try and get more space from the end */
-        unsigned char *src, *dst;
-
-        dst = (cmdbuf_base + sizeof(cmdbuf_base) - 1);  /* max pointer */
-
-        if ((cmdbuf_ptr + n) > dst)
-            n = (dst - cmdbuf_ptr);     /* max # chars to insert */
-
-        if ((cmdbuf_endp + n) > dst)
-            cmdbuf_endp = (dst - n);    /* truncate end if needed */
-
-        /* equiv: memmove ((cmdbuf_ptr+n), cmdbuf_ptr, n); */
-        src = cmdbuf_endp;
-        dst = src + n;
-        /* FIXME: anything special to avoid possible pointer wrap? */
-        while (src >= cmdbuf_ptr)
-            *dst-- = *src--;
-
-        /* done */
-        cmdbuf_ptr += n;
-        cmdbuf_endp += n;
-    }
-    while (count-- && cmdbuf_ptr > cmdbuf_base) {
-        /* sneak one in */
-        cmdbuf_ptr--;
-        *cmdbuf_ptr = str[count];
+    /* need to insert more chars than space available in the front */
+    if (count > (unsigned long) (cmdbuf_ptr - cmdbuf_base)) {
+        if (len + count > cmdbuf_size) {
+            cmdbuf_resize(len + count);
+        }
+        memmove(cmdbuf_base + count, cmdbuf_ptr, len);
+        cmdbuf_ptr = cmdbuf_base + count;
+        cmdbuf_endp = cmdbuf_ptr + len;
     }
+    cmdbuf_ptr -= count;
+    memcpy(cmdbuf_ptr, str, count);
 
     return (0);
 }
@@ -3303,6 +3329,68 @@ check_pixmap_change(int sig)
 }
 #endif /* BACKGROUND_CYCLING_SUPPORT */
 
+/* Refresh scheduling.  Output is parsed as fast as it comes in, and the screen is redrawn at
+   most once every 1/rs_frame_rate seconds:  as soon as the parser has caught up, or while it
+   is still busy, once the oldest change not on the screen yet is rs_max_latency ms old. */
+static struct timeval last_frame, first_change;
+static unsigned char refresh_owed = 0;
+
+static long
+usec_since(struct timeval *tv)
+{
+    struct timeval now;
+
+    timer_now(&now);
+    return ((now.tv_sec - tv->tv_sec) * 1000000 + (now.tv_usec - tv->tv_usec));
+}
+
+/* Something has changed that isn't on the screen yet. */
+static void
+refresh_owe(unsigned long bytes)
+{
+    if (!refresh_owed) {
+        refresh_owed = 1;
+        timer_now(&first_change);
+    }
+    frame_bytes += bytes;
+}
+
+/* How many microseconds until the next frame may be drawn. */
+static long
+frame_wait(void)
+{
+    long elapsed, interval;
+
+    if (!rs_frame_rate) {
+        return 0;
+    }
+    interval = 1000000 / rs_frame_rate;
+    elapsed = usec_since(&last_frame);
+    return ((elapsed >= 0 && elapsed < interval) ? (interval - elapsed) : 0);
+}
+
+/* Has the screen been lagging behind for too long? */
+static unsigned char
+frame_overdue(void)
+{
+    return (refresh_owed && !frame_wait() && usec_since(&first_change) >= (long) rs_max_latency * 1000);
+}
+
+static void
+frame_draw(void)
+{
+    D_CMD(("Frame %lu:  %lu bytes read since the last one.\n", frames_drawn, frame_bytes));
+    refresh_owed = 0;
+    frames_drawn++;
+    frame_bytes = 0;
+    timer_now(&last_frame);
+    scr_refresh(refresh_type);
+    if (CHARS_READ()) {
+        /* the rest of what was read is still to be parsed */
+        refresh_owe(0);
+    }
+}
+
 /* cmd_getc() - Return next input character */
 /*
  * Return the next input character after first passing any keyboard input
@@ -3312,30 +3400,22 @@ unsigned char
 cmd_getc(void)
 {
 #define TIMEOUT_USEC 2500
-    static short refreshed = 0;
-    fd_set readfds;
-    int retval;
-    struct timeval value, *delay;
-
-    /* If there has been a lot of new lines, then update the screen
-     * What the heck I'll cheat and only refresh less than every page-full.
-     * the number of pages between refreshes is refresh_limit, which
-     * is incremented here because we must be doing flat-out scrolling.
-     *
-     * refreshing should be correct for small scrolls, because of the
-     * time-out
-     */
-    if (refresh_count >= (refresh_limit * (TERM_WINDOW_GET_ROWS() - 1))) {
-        D_CMD(("Refresh count %d >= limit %d * rows.  (Refresh period %d.)\n", refresh_count, refresh_limit, REFRESH_PERIOD));
-        if (refresh_limit < REFRESH_PERIOD)
-            refresh_limit++;
+    int retval, save_errno;
+    long delay;
+
+    /* scan_text() stops after a screenful of newlines, so flat-out scrolling comes back here
+       regularly even with plenty left to parse.  Draw a frame if the screen is lagging too far
+       behind. */
+    if (refresh_count >= (TERM_WINDOW_GET_ROWS() - 1)) {
         refresh_count = 0;
-        refreshed = 1;
+        if (frame_overdue()) {
+            D_CMD(("Output has been waiting %ld usec, drawing a frame.\n", usec_since(&first_change)));
 #ifdef PROFILE
-        P_CALL(scr_refresh(refresh_type), "cmd_getc()->scr_refresh()");
+            P_CALL(frame_draw(), "cmd_getc()->frame_draw()");
 #else
-        scr_refresh(refresh_type);
+            frame_draw();
 #endif
+        }
     }
 #ifdef ESCREEN
     if (TermWin.screen) {
@@ -3388,11 +3468,18 @@ cmd_getc(void)
 
     for (;;) {
         v_doPending();
+        selection_fetch_resume();
+        /* Output that never stops still gets a frame now and then.  Before the events are
+           drained, since Xlib may queue some while flushing the drawing, and they'd sit there
+           through the sleep below. */
+        if (frame_overdue()) {
+            frame_draw();
+        }
         while (XPending(Xdisplay)) {    /* process pending X events */
 
             XEvent ev;
 
-            refreshed = 0;
+            refresh_owe(0);
             XNextEvent(Xdisplay, &ev);
 
 #ifdef USE_XIM
@@ -3421,66 +3508,69 @@ cmd_getc(void)
                 cmd_write((unsigned char *) rs_finished_text, strlen(rs_finished_text));
             }
         } else if (!paused && pipe_fd < 0 && cmd_fd < 0) {
-            exit(0);
+            normal_exit(0);
         }
 #ifdef SCROLLBAR_BUTTON_CONTINUAL_SCROLLING
         if (scrollbar_uparrow_is_pressed()) {
             if (!scroll_arrow_delay-- && scr_page(UP, 1)) {
                 scroll_arrow_delay = SCROLLBAR_CONTINUOUS_DELAY;
-                refreshed = 0;
+                refresh_owe(0);
             }
         } else if (scrollbar_downarrow_is_pressed()) {
             if (!scroll_arrow_delay-- && scr_page(DN, 1)) {
                 scroll_arrow_delay = SCROLLBAR_CONTINUOUS_DELAY;
-                refreshed = 0;
+                refresh_owe(0);
             }
         }
 #endif /* SCROLLBAR_BUTTON_CONTINUAL_SCROLLING */
 
-        /* Nothing to do! */
-        FD_ZERO(&readfds);
+        /* Nothing to do!  Sleep until there is input, the pty can take more of a paste,
+           the screen is due for a refresh, or the next timer goes off. */
         if (cmd_fd >= 0) {
-            FD_SET(cmd_fd, &readfds);
+            loop_watch(cmd_fd, LOOP_READ | (v_len ? LOOP_WRITE : 0));
         }
-        FD_SET(Xfd, &readfds);
+        loop_watch(Xfd, LOOP_READ);
         if (pipe_fd >= 0) {
-            FD_SET(pipe_fd, &readfds);
+            loop_watch(pipe_fd, LOOP_READ);
         }
-        value.tv_usec = TIMEOUT_USEC;
-        value.tv_sec = 0;
 
-        if (refreshed
+        /* With a refresh owed, wait no longer than the next frame; if nothing else turns up
+           by then, the parser has caught up and the frame gets drawn. */
+        delay = (refresh_owed ? frame_wait() : -1);
 #ifdef SCROLLBAR_BUTTON_CONTINUAL_SCROLLING
-            && !(scrollbar_arrow_is_pressed())
-#endif
-            ) {
-            delay = NULL;
-        } else {
-            delay = &value;
+        if (scrollbar_arrow_is_pressed() && (delay < 0 || delay > TIMEOUT_USEC)) {
+            delay = TIMEOUT_USEC;
         }
-        retval = select(num_fds, &readfds, NULL, NULL, delay);
+#endif
+        delay = timer_next_delay(delay);
+        retval = loop_wait(delay);
+        save_errno = errno;     /* before any timer handler gets a chance to change it */
+        timer_check();
 
         if (retval < 0) {
-            if (cmd_fd >= 0 && FD_ISSET(cmd_fd, &readfds)) {
-                if (errno != EINTR) {   /* may have rcvd SIGCHLD or so */
-                    libast_print_error(" (%ld) Error reading from tty -- %s\n", getpid(), strerror(errno));
-                    cmd_fd = -1;
+            if (save_errno != EINTR) {  /* may have rcvd SIGCHLD or so */
+                if (cmd_fd >= 0) {
+                    libast_print_error(" (%ld) Error reading from tty -- %s\n", getpid(), strerror(save_errno));
+                    FORGET_FD(cmd_fd);
+                }
+                if (pipe_fd >= 0) {
+                    libast_print_error("Error reading from pipe -- %s\n", strerror(save_errno));
+                    FORGET_FD(pipe_fd);
                 }
-            }
-            if (pipe_fd >= 0 && FD_ISSET(pipe_fd, &readfds)) {
-                libast_print_error("Error reading from pipe -- %s\n", strerror(errno));
-                pipe_fd = -1;
             }
             if (pipe_fd < 0 && cmd_fd < 0 && !paused) {
-                exit(errno);
+                normal_exit(save_errno);
             }
         } else if (retval == 0) {
             refresh_count = 0;
-            refresh_limit = 1;
-            if (!refreshed) {
-                refreshed = 1;
-                D_CMD(("select() timed out, time to update the screen.\n"));
-                scr_refresh(refresh_type);
+            if (cmdbuf_size > CMD_BUF_SIZE && !CHARS_READ()) {
+                /* The burst is over; give back the big buffer. */
+                cmdbuf_ptr = cmdbuf_endp = cmdbuf_base;
+                cmdbuf_resize(CMD_BUF_SIZE);
+            }
+            if (refresh_owed && !frame_wait()) {
+                D_CMD(("Wait timed out, time to update the screen.\n"));
+                frame_draw();
                 if (scrollbar_is_visible()) {
                     scrollbar_anchor_update_position(1);
                 }
@@ -3490,11 +3580,12 @@ cmd_getc(void)
             }
         } else {
             /* We have something to read from. */
-            if (cmd_fd >= 0 && FD_ISSET(cmd_fd, &readfds)) {
+            if (cmd_fd >= 0 && (loop_ready(cmd_fd) & LOOP_READ)) {
                 /* See if we can read from the application */
-                register unsigned int count = CMD_BUF_SIZE;
+                register unsigned long count;
 
                 cmdbuf_ptr = cmdbuf_endp = cmdbuf_base;
+                count = cmdbuf_size;
                 while (count) {
                     register int n = read(cmd_fd, cmdbuf_endp, count);
 
@@ -3507,7 +3598,7 @@ cmd_getc(void)
                             break;
                         } else {
                             /* Our file descriptor went bye-bye. */
-                            cmd_fd = -1;
+                            FORGET_FD(cmd_fd);
                             if (!paused && (BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_PAUSE))) {
                                 paused = 1;
                             }
@@ -3515,7 +3606,7 @@ cmd_getc(void)
                         }
                     } else if (n == 0) {
                         /* EOF */
-                        cmd_fd = -1;
+                        FORGET_FD(cmd_fd);
                         if (!paused && (BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_PAUSE))) {
                             paused = 1;
                         }
@@ -3524,15 +3615,22 @@ cmd_getc(void)
                     cmdbuf_endp += n;
                     count -= n;
                 }
+                if (!count && cmdbuf_size < CMD_BUF_MAX) {
+                    /* Filled the whole buffer, so there is probably more coming.  Read
+                       twice as much per wakeup from now on. */
+                    cmdbuf_resize(MIN(cmdbuf_size * 2, CMD_BUF_MAX));
+                }
                 /* some characters read in */
                 if (CHARS_BUFFERED()) {
+                    refresh_owe(cmdbuf_endp - cmdbuf_base);
                     RETURN_CHAR();
                 }
             }
-            if (pipe_fd >= 0 && FD_ISSET(pipe_fd, &readfds)) {
-                register unsigned int count = CMD_BUF_SIZE / 2;
+            if (pipe_fd >= 0 && (loop_ready(pipe_fd) & LOOP_READ)) {
+                register unsigned long count;
 
                 cmdbuf_ptr = cmdbuf_endp = cmdbuf_base;
+                count = cmdbuf_size / 2;
                 while (count) {
 
                     register int n = read(pipe_fd, cmdbuf_endp, count);
@@ -3546,12 +3644,12 @@ cmd_getc(void)
                             break;
                         } else {
                             /* Our file descriptor went bye-bye. */
-                            pipe_fd = -1;
+                            FORGET_FD(pipe_fd);
                             break;
                         }
                     } else if (n == 0) {
                         /* EOF */
-                        pipe_fd = -1;
+                        FORGET_FD(pipe_fd);
                         break;
                     }
                     n = add_carriage_returns(cmdbuf_endp, n);
@@ -3560,6 +3658,7 @@ cmd_getc(void)
                 }
                 /* some characters read in */
                 if (CHARS_BUFFERED()) {
+                    refresh_owe(cmdbuf_endp - cmdbuf_base);
                     RETURN_CHAR();
                 }
             }
@@ -3568,13 +3667,6 @@ cmd_getc(void)
     return (0);
 }
 
-/* Put a character back in the buffer.  Only use this once at a time. */
-void
-cmd_ungetc(void)
-{
-    cmdbuf_ptr--;
-}
-
 /* tt_write(), tt_printf() - output to command */
 /*
  * Send count characters directly to the command
@@ -3584,17 +3676,18 @@ tt_write(const unsigned char *buf, unsigned int count)
 {
 
     v_writeBig(cmd_fd, (char *) buf, count);
+}
 
-#if 0                           /* Fixes the bug that hung Eterm when pasting a lot of stuff */
-    while (count > 0) {
-        int n = write(cmd_fd, buf, count);
-
-        if (n > 0) {
-            count -= n;
-            buf += n;
-        }
-    }
-#endif
+/*
+ * Send pasted text to the command, newlines and all.  The newlines become
+ * carriage returns as the text is queued, so it goes out in as few writes
+ * as the pty allows rather than a line at a time.
+ */
+void
+tt_paste(const unsigned char *buf, unsigned int count)
+{
+    v_append((const char *) buf, count, 1);
+    v_drain(cmd_fd);
 }
 
 /*
@@ -3613,6 +3706,70 @@ tt_printf(const unsigned char *fmt, ...)
     tt_write(buf, strlen((char *) buf));
 }
 
+/*
+ * Find the end of the text starting at <str>:  the first control character
+ * other than tab, newline, and carriage return, or the newline which brings
+ * refresh_count up to a screenful.  Newlines are added to <nlines> and
+ * refresh_count as they are passed.
+ */
+static unsigned char *
+scan_text(unsigned char *str, unsigned char *endp, int *nlines)
+{
+    register unsigned char *p = str;
+    register int ch;
+    int limit = TERM_WINDOW_GET_ROWS() - 1;
+
+    /* Whenever the compiler is targeting SSE2 (always, on x86_64), not just with --enable-sse2. */
+#ifdef __SSE2__
+    {
+        /* Check 16 bytes at a time, and leave any block holding the last allowed
+           newline to the byte loop below. */
+        const __m128i below = _mm_set1_epi8(' ' - 1);
+        const __m128i tab = _mm_set1_epi8('\t'), lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+        __m128i v;
+        unsigned int ctrl, newlines;
+        int n;
+
+        for (; p + 16 <= endp; p += 16) {
+            v = _mm_loadu_si128((const __m128i *) p);
+            ctrl = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, below), below));
+            if (!ctrl) {
+                continue;
+            }
+            newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+            ctrl &= ~(newlines | _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr))));
+            if (ctrl) {
+                newlines &= (ctrl & -ctrl) - 1;
+            }
+            n = __builtin_popcount(newlines);
+            if (refresh_count + n >= limit) {
+                break;
+            }
+            *nlines += n;
+            refresh_count += n;
+            if (ctrl) {
+                return (p + __builtin_ctz(ctrl));
+            }
+        }
+    }
+#endif
+    while (p < endp) {
+        ch = *p++;
+        if (ch >= ' ' || ch == '\t' || ch == '\r') {
+            NOP;
+        } else if (ch == '\n') {
+            (*nlines)++;
+            if (++refresh_count >= limit)
+                break;
+        } else {
+            /* unprintable */
+            p--;
+            break;
+        }
+    }
+    return p;
+}
+
 /* Read and process output from the application */
 void
 main_loop(void)
@@ -3621,7 +3778,7 @@ main_loop(void)
     register int ch;
 
     D_CMD(("PID %d\n", getpid()));
-    D_CMD(("Command buffer base == %8p, length %lu, end at %8p\n", cmdbuf_base, CMD_BUF_SIZE, cmdbuf_base + CMD_BUF_SIZE - 1));
+    D_CMD(("Command buffer base == %8p, length %lu, end at %8p\n", cmdbuf_base, cmdbuf_size, cmdbuf_base + cmdbuf_size - 1));
 
 #ifdef BACKGROUND_CYCLING_SUPPORT
     if (rs_anim_delay) {
@@ -3631,7 +3788,10 @@ main_loop(void)
 
     do {
         while ((ch = cmd_getc()) == 0); /* wait for something */
-        if (ch >= ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+        if (escape_seq_pending()) {
+            /* Pick up the rest of a sequence split across reads. */
+            cmdbuf_ptr = process_escape_seq(cmdbuf_ptr - 1, cmdbuf_endp);
+        } else if (ch >= ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
             /* Read a text string from the input buffer */
             int nlines = 0;
             unsigned char *str;
@@ -3644,30 +3804,21 @@ main_loop(void)
              * decrement first since already did get_com_char ()
              */
             str = --cmdbuf_ptr;
-            while (cmdbuf_ptr < cmdbuf_endp) {
-
-                ch = *cmdbuf_ptr++;
+            cmdbuf_ptr = scan_text(str, cmdbuf_endp, &nlines);
 #if DEBUG >= DEBUG_VT
-                if (DEBUG_LEVEL >= DEBUG_VT) {
+            if (DEBUG_LEVEL >= DEBUG_VT) {
+                unsigned char *p;
+
+                for (p = str; p < cmdbuf_ptr; p++) {
+                    ch = *p;
                     if (ch < 32) {
                         D_VT(("\'%s\' (%d 0x%02x %03o)\n", get_ctrl_char_name(ch), ch, ch, ch));
                     } else {
                         D_VT(("\'%c\' (%d 0x%02x %03o)\n", ch, ch, ch, ch));
                     }
                 }
-#endif
-                if (ch >= ' ' || ch == '\t' || ch == '\r') {
-                    NOP;
-                } else if (ch == '\n') {
-                    nlines++;
-                    if (++refresh_count >= (refresh_limit * (TERM_WINDOW_GET_ROWS() - 1)))
-                        break;
-                } else {
-                    /* unprintable */
-                    cmdbuf_ptr--;
-                    break;
-                }
             }
+#endif
             D_SCREEN(("Adding %d lines (%d chars); str == %8p, cmdbuf_ptr == %8p, cmdbuf_endp == %8p\n",
                       nlines, cmdbuf_ptr - str, str, cmdbuf_ptr, cmdbuf_endp));
 #if FIXME_BLOCK
@@ -3780,127 +3931,141 @@ main_loop(void)
                     scr_charset_choose(0);
                     break;
                 case 033:
-                    process_escape_seq();
+                    cmdbuf_ptr = process_escape_seq(cmdbuf_ptr - 1, cmdbuf_endp);
                     break;
             }
         }
     } while (ch != EOF);
 }
 
-/* output a burst of any pending data from a paste... */
-int
-v_doPending(void)
+/* Make room in the ring for len more bytes, unwrapping its contents into a larger one if
+   need be.  Returns 0 if the memory isn't there. */
+static unsigned char
+v_grow(unsigned long len)
 {
+    unsigned long size, tail;
+    char *buff;
 
-    if (v_bufstr >= v_bufptr)
-        return (0);
-    v_writeBig(cmd_fd, NULL, 0);
-    return (1);
+    if (v_len + len <= v_size) {
+        return 1;
+    }
+    for (size = (v_size ? v_size : V_BUF_MIN); size < v_len + len; size <<= 1);
+    if (!(buff = (char *) MALLOC(size))) {
+        libast_print_error("cannot allocate buffer space\n");
+        return 0;
+    }
+    tail = MIN(v_len, v_size - v_head);
+    if (tail) {
+        memcpy(buff, v_buffer + v_head, tail);
+        if (v_len > tail) {
+            memcpy(buff + tail, v_buffer, v_len - tail);
+        }
+    }
+    if (v_buffer) {
+        FREE(v_buffer);
+    }
+    D_TTY(("Output ring grown to %lu bytes (%lu queued)\n", size, v_len));
+    v_buffer = buff;
+    v_size = size;
+    v_head = 0;
+    return 1;
 }
 
-/* Write data to the pty as typed by the user, pasted with the mouse,
- * or generated by us in response to a query ESC sequence.
- * Code stolen from xterm 
- */
-void
-v_writeBig(int f, char *d, int len)
+/* Turn every newline in a stretch of the ring into a carriage return. */
+static void
+v_newlines(char *p, unsigned long n)
 {
+    char *end = p + n;
 
-    int written;
-    int c = len;
+    for (; (p = memchr(p, '\n', end - p)); *p++ = '\r');
+}
 
-    if (!v_bufstr && len > 0) {
+/* Queue len bytes for the pty, converting newlines to carriage returns if asked. */
+static void
+v_append(const char *d, unsigned long len, unsigned char newlines)
+{
+    unsigned long tail, n;
 
-        v_buffer = MALLOC(len);
-        v_bufstr = v_buffer;
-        v_bufptr = v_buffer;
-        v_bufend = v_buffer + len;
+    if (!len || !v_grow(len)) {
+        return;
     }
-    /*
-     * Append to the block we already have.
-     * Always doing this simplifies the code, and
-     * isn't too bad, either.  If this is a short
-     * block, it isn't too expensive, and if this is
-     * a long block, we won't be able to write it all
-     * anyway.
-     */
+    tail = (v_head + v_len) & (v_size - 1);
+    n = MIN(len, v_size - tail);
+    memcpy(v_buffer + tail, d, n);
+    if (len > n) {
+        memcpy(v_buffer, d + n, len - n);
+    }
+    if (newlines) {
+        v_newlines(v_buffer + tail, n);
+        v_newlines(v_buffer, len - n);
+    }
+    v_len += len;
+}
 
-    if (len > 0) {
-        if (v_bufend < v_bufptr + len) {        /* we've run out of room */
-            if (v_bufstr != v_buffer) {
-                /* there is unused space, move everything down */
-                /* possibly overlapping bcopy here */
-
-                /* bcopy(v_bufstr, v_buffer, v_bufptr - v_bufstr); */
-                memcpy(v_buffer, v_bufstr, v_bufptr - v_bufstr);
-                v_bufptr -= v_bufstr - v_buffer;
-                v_bufstr = v_buffer;
-            }
-            if (v_bufend < v_bufptr + len) {
-                /* still won't fit: get more space */
-                /* Don't use XtRealloc because an error is not fatal. */
-                int size = v_bufptr - v_buffer; /* save across realloc */
-
-                v_buffer = REALLOC(v_buffer, size + len);
-                if (v_buffer) {
-                    v_bufstr = v_buffer;
-                    v_bufptr = v_buffer + size;
-                    v_bufend = v_bufptr + len;
-                } else {
-                    /* no memory: ignore entire write request */
-                    libast_print_error("cannot allocate buffer space\n");
-                    v_buffer = v_bufstr;        /* restore clobbered pointer */
-                    c = 0;
-                }
+/* Write out as much of the ring as the pty will take right now.  cmd_fd is non-blocking,
+   so a short write or EAGAIN just means the rest waits for the main loop to see it writable. */
+static void
+v_drain(int f)
+{
+    unsigned long n;
+    int written;
+
+    while (v_len) {
+        n = MIN(v_len, v_size - v_head);
+        if ((written = write(f, v_buffer + v_head, n)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                /* The other end is gone; nobody is going to read the rest. */
+                D_TTY(("Dropping %lu characters after write error %d\n", v_len, errno));
+                v_len = 0;
             }
+            break;
         }
-        if (v_bufend >= v_bufptr + len) {       /* new stuff will fit */
-            memcpy(v_bufptr, d, len);   /* bcopy(d, v_bufptr, len); */
-            v_bufptr += len;
+        D_TTY(("Wrote %d of %lu characters\n", written, v_len));
+        v_head = (v_head + written) & (v_size - 1);
+        v_len -= written;
+        if ((unsigned long) written < n) {
+            break;
         }
     }
-    /*
-     * Write out as much of the buffer as we can.
-     * Be careful not to overflow the pty's input silo.
-     * We are conservative here and only write
-     * a small amount at a time.
-     *
-     * If we can't push all the data into the pty yet, we expect write
-     * to return a non-negative number less than the length requested
-     * (if some data written) or -1 and set errno to EAGAIN,
-     * EWOULDBLOCK, or EINTR (if no data written).
-     *
-     * (Not all systems do this, sigh, so the code is actually
-     * a little more forgiving.)
-     */
-
-    if (v_bufptr > v_bufstr) {
-        written = write(f, v_bufstr, v_bufptr - v_bufstr <= MAX_PTY_WRITE ? v_bufptr - v_bufstr : MAX_PTY_WRITE);
-        if (written < 0) {
-            written = 0;
+    if (!v_len) {
+        v_head = 0;
+        if (v_size > V_BUF_KEEP) {
+            FREE(v_buffer);
+            v_size = 0;
         }
-        D_TTY(("Wrote %d characters\n", written));
-        v_bufstr += written;
-        if (v_bufstr >= v_bufptr)       /* we wrote it all */
-            v_bufstr = v_bufptr = v_buffer;
     }
-    /*
-     * If we have lots of unused memory allocated, return it
-     */
-    if (v_bufend - v_bufptr > 1024) {   /* arbitrary hysteresis */
-        /* save pointers across realloc */
-        int start = v_bufstr - v_buffer;
-        int size = v_bufptr - v_buffer;
-        int allocsize = size ? size : 1;
-
-        v_buffer = REALLOC(v_buffer, allocsize);
-        if (v_buffer) {
-            v_bufstr = v_buffer + start;
-            v_bufptr = v_buffer + size;
-            v_bufend = v_buffer + allocsize;
-        } else {
-            /* should we print a warning if couldn't return memory? */
-            v_buffer = v_bufstr - start;        /* restore clobbered pointer */
-        }
+}
+
+/* How many bytes are still waiting to go to the pty. */
+unsigned long
+tt_pending(void)
+{
+    return v_len;
+}
+
+/* output a burst of any pending data from a paste... */
+int
+v_doPending(void)
+{
+    if (!v_len) {
+        return (0);
+    }
+    v_drain(cmd_fd);
+    return (1);
+}
+
+/* Write data to the pty as typed by the user, pasted with the mouse,
+ * or generated by us in response to a query ESC sequence.  Whatever
+ * the pty won't take right away stays queued behind anything already
+ * waiting, so ordering is preserved.
+ */
+void
+v_writeBig(int f, char *d, int len)
+{
+    if (len > 0) {
+        v_append(d, len, 0);
     }
+    v_drain(f);
 }
@@ -99,6 +99,7 @@
 /* #define PrivMode_MouseX11Track	(1LU<<13) */
 # define PrivMode_scrollbar	(1LU<<14)
 # define PrivMode_menuBar	(1LU<<15)
+# define PrivMode_BracketPaste	(1LU<<16)
 
 #define PrivMode_mouse_report	(PrivMode_MouseX10|PrivMode_MouseX11)
 #define PrivMode(test,bit) do {\
@@ -205,9 +206,11 @@ if (test) PrivateModes |= (bit); else PrivateModes &= ~(bit);} while (0)
 #define STRING_MAX	512	/* max string size for process_xterm_seq() */
 #define ESC_ARGS	32	/* max # of args for esc sequences */
 
-/* a large REFRESH_PERIOD causes problems with `cat' */
-#ifndef REFRESH_PERIOD
-# define REFRESH_PERIOD	3
+#ifndef FRAME_RATE
+# define FRAME_RATE	60
+#endif
+#ifndef MAX_LATENCY
+# define MAX_LATENCY	50
 #endif
 
 #ifndef MULTICLICK_TIME
@@ -252,6 +255,9 @@ if (test) PrivateModes |= (bit); else PrivateModes &= ~(bit);} while (0)
 #  define CMD_BUF_SIZE 4096
 # endif
 #endif
+#ifndef CMD_BUF_MAX
+# define CMD_BUF_MAX (1024 * 1024)
+#endif
 
 #if !defined(EACCESS) && defined(EAGAIN)
 # define EACCESS EAGAIN
@@ -267,43 +273,22 @@ if (test) PrivateModes |= (bit); else PrivateModes &= ~(bit);} while (0)
 #endif
 
 #define CHARS_READ()      (cmdbuf_ptr < cmdbuf_endp)
-#define CHARS_BUFFERED()  (count != CMD_BUF_SIZE)
+#define CHARS_BUFFERED()  (cmdbuf_endp > cmdbuf_base)
 #define RETURN_CHAR()     do { \
                             unsigned char c = *cmdbuf_ptr++; \
-                            refreshed = 0; \
                             if (c < 32) D_VT(("RETURN_CHAR():  \'%s\' (%d 0x%02x %03o)\n", get_ctrl_char_name(c), c, c, c)); \
                             else D_VT(("RETURN_CHAR():  \'%c\' (%d 0x%02x %03o)\n", c, c, c, c)); \
                             return (c); \
                           } while (0)
+#define FORGET_FD(fd)     do { \
+                            loop_watch((fd), 0); \
+                            (fd) = -1; \
+                          } while (0)
 
 #ifdef REFRESH_DELAY
 # define REFRESH_DELAY_USEC (1000000/25)
 #endif
 
-#if defined(linux)
-# ifdef PTY_BUF_SIZE		/* From <linux/tty.h> */
-#  define MAX_PTY_WRITE PTY_BUF_SIZE
-# endif
-#endif
-
-/* NOTE: _POSIX_MAX_INPUT is defined _through_ <limits.h> at least for
- * the following systems: HP-UX 10.20, AIX (no idea about the version),
- * OSF1/alpha 4.0, Linux (probably any Linux system).
- */
-#ifndef MAX_PTY_WRITE
-# ifdef _POSIX_VERSION
-#  ifdef _POSIX_MAX_INPUT
-#   define MAX_PTY_WRITE _POSIX_MAX_INPUT
-#  else
-#   define MAX_PTY_WRITE 255	/* POSIX minimum MAX_INPUT */
-#  endif
-# endif
-#endif
-
-#ifndef MAX_PTY_WRITE
-# define MAX_PTY_WRITE 128	/* 1/2 POSIX minimum MAX_INPUT */
-#endif
-
 /************ Structures ************/
 /* Motif window hints */
 # ifdef LONG64
@@ -341,7 +326,8 @@ extern int my_ruid, my_rgid, my_euid, my_egid;
 extern int pipe_fd;
 extern char initial_dir[PATH_MAX+1];
 extern unsigned long PrivateModes;
-extern int refresh_count, refresh_limit, refresh_type;
+extern int refresh_count, refresh_type;
+extern unsigned long frames_drawn, frame_bytes;
 extern pid_t cmd_pid;
 #ifdef USE_XIM
 extern XIC xim_input_context;	/* input context */
@@ -362,6 +348,7 @@ extern const char *get_ctrl_char_name(char);
 extern void dump_stack_trace(void);
 extern void install_handlers(void);
 extern void clean_exit(void);
+extern void normal_exit(int);
 extern int get_pty(void);
 extern int get_tty(void);
 extern XFontSet create_fontset(const char *, const char *);
@@ -383,11 +370,12 @@ extern unsigned int cmd_write(const unsigned char *, unsigned int);
 extern RETSIGTYPE check_pixmap_change(int);
 #endif
 extern unsigned char cmd_getc(void);
-extern void cmd_ungetc(void);
 extern void tt_write(const unsigned char *, unsigned int);
+extern void tt_paste(const unsigned char *, unsigned int);
 extern void tt_printf(const unsigned char *, ...);
 extern void main_loop(void);
 extern int v_doPending(void);
+extern unsigned long tt_pending(void);
 extern void v_writeBig(int, char *, int);
 
 _XFUNCPROTOEND
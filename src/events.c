@@ -151,6 +151,7 @@ event_init_primary_dispatcher(void)
     EVENT_DATA_ADD_HANDLER(primary_data, SelectionRequest, handle_selection_request);
     EVENT_DATA_ADD_HANDLER(primary_data, GraphicsExpose, handle_expose);
     EVENT_DATA_ADD_HANDLER(primary_data, Expose, handle_expose);
+    EVENT_DATA_ADD_HANDLER(primary_data, NoExpose, handle_no_expose);
     EVENT_DATA_ADD_HANDLER(primary_data, ButtonPress, handle_button_press);
     EVENT_DATA_ADD_HANDLER(primary_data, ButtonRelease, handle_button_release);
     EVENT_DATA_ADD_HANDLER(primary_data, MotionNotify, handle_motion_notify);
@@ -293,10 +294,13 @@ handle_property_notify(event_t *ev)
         D_EVENTS(("PropertyNotify on term window for atom %d, state %d.  Selection atoms are %d and %d.\n", ev->xproperty.atom,
                   ev->xproperty.state, props[PROP_SELECTION_DEST], props[PROP_SELECTION_INCR]));
         if (ev->xproperty.atom == props[PROP_SELECTION_DEST] && ev->xproperty.state == PropertyNewValue) {
-            D_SELECT(("Fetching next part of incremental selection.\n"));
-            selection_fetch(ev->xproperty.window, ev->xproperty.atom, True);
+            selection_fetch_incr(ev->xproperty.window, ev->xproperty.atom);
         }
     }
+    if (ev->xproperty.state == PropertyDelete) {
+        /* Someone we're sending a large selection to is ready for the next chunk. */
+        selection_send_incr(ev->xproperty.window, ev->xproperty.atom);
+    }
     return 1;
 }
 
@@ -314,9 +318,11 @@ handle_destroy_notify(event_t *ev)
     } else if (XEVENT_IS_MYWIN(ev, &primary_data)) {
         /* One of our main windows was deleted.  Exit cleanly. */
         D_EVENTS((" -> Primary window destroyed.  Terminating.\n"));
-        exit(0);
+        normal_exit(0);
         ASSERT_NOTREACHED_RVAL(1);
     }
+    /* Maybe someone we were sending a large selection to. */
+    selection_send_destroyed(ev->xdestroywindow.window);
     return 0;
 }
 
@@ -329,7 +335,7 @@ handle_client_message(event_t *ev)
     REQUIRE_RVAL(XEVENT_IS_MYWIN(ev, &primary_data), 0);
 
     if (ev->xclient.format == 32 && ev->xclient.data.l[0] == (signed) props[PROP_DELETE_WINDOW])
-        exit(EXIT_SUCCESS);
+        normal_exit(EXIT_SUCCESS);
     if (ev->xclient.format == 8 && ev->xclient.message_type == props[PROP_ENL_MSG]) {
         char buff[13];
         unsigned char i;
@@ -623,18 +629,39 @@ handle_expose(event_t *ev)
             refresh_type = FAST_REFRESH;
         }
         scr_expose(ev->xexpose.x, ev->xexpose.y, ev->xexpose.width, ev->xexpose.height);
+        if (ev->type == GraphicsExpose && !ev->xgraphicsexpose.count && scroll_blits_pending) {
+            /* The last of the damage from a scroll blit. */
+            scroll_blits_pending--;
+        }
     } else {
 
         XEvent unused_xevent;
 
         while (XCheckTypedWindowEvent(Xdisplay, ev->xany.window, Expose, &unused_xevent));
         while (XCheckTypedWindowEvent(Xdisplay, ev->xany.window, GraphicsExpose, &unused_xevent));
+        if (ev->xany.window == TermWin.vt) {
+            /* Anything blitted onto the window before there was a buffer pixmap is covered. */
+            scroll_blits_pending = 0;
+        }
     }
     PROF_DONE(handle_expose);
     PROF_TIME(handle_expose);
     return 1;
 }
 
+/* A scroll blit onto the window came through without any damage. */
+unsigned char
+handle_no_expose(event_t *ev)
+{
+    D_EVENTS(("handle_no_expose(ev [%8p] on window 0x%08x)\n", ev, ev->xany.window));
+
+    REQUIRE_RVAL(XEVENT_IS_MYWIN(ev, &primary_data), 0);
+    if (ev->xnoexpose.drawable == TermWin.vt && scroll_blits_pending) {
+        scroll_blits_pending--;
+    }
+    return 1;
+}
+
 unsigned char
 handle_button_press(event_t *ev)
 {
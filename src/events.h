@@ -112,6 +112,7 @@ extern unsigned char handle_selection_clear(event_t *);
 extern unsigned char handle_selection_notify(event_t *);
 extern unsigned char handle_selection_request(event_t *);
 extern unsigned char handle_expose(event_t *);
+extern unsigned char handle_no_expose(event_t *);
 extern unsigned char handle_button_press(event_t *);
 extern unsigned char handle_button_release(event_t *);
 extern unsigned char handle_motion_notify(event_t *);
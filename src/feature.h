@@ -112,9 +112,18 @@
 /* Disable the secondary screen ("\E[?47h" / "\E[?47l") */
 /* #define NO_SECONDARY_SCREEN */
 
-/* The number of screenfuls between refreshes.  Anything higher than 1
- * will cause gaps in the scrollback buffer. */
-# define REFRESH_PERIOD  1
+/* How many times a second the screen is redrawn, at most, while output is
+ * arriving, and how long (in milliseconds) it may lag behind output that is
+ * still being read.  These are the defaults for --frame-rate and
+ * --max-latency. */
+# define FRAME_RATE   60
+# define MAX_LATENCY  50
+
+/* How much pixmap memory (in bytes, on the X server) to spend on keeping rendered
+ * images around for the scrollbar, button bars and menus, so that switching them
+ * between their normal, selected and clicked states doesn't mean rendering them
+ * all over again. */
+# define RENDER_CACHE_SIZE  (4 * 1024 * 1024)
 
 /* This will force clearing of characters before writing new ones on top of
  * them. This is experimental - added in order to try and fix pixel dropping
@@ -161,6 +170,10 @@
 /* Set the default number of lines in the scrollback buffer */
 /* #define SAVELINES 256 */
 
+/* Set the default number of scrollback lines kept unpacked.  Anything older
+ * is packed until something looks at it again.  0 never packs anything. */
+/* #define COLDLINES 1024 */
+
 /* Set the default separator characters for double-click word selection */
 #define CUTCHARS "\"&'()*,;<=>?@[\\]^`{|} \t"
 
@@ -281,6 +294,10 @@ inline void *memmove(void *, const void *, size_t);
 # define SAVELINES 256
 #endif
 
+#ifndef COLDLINES
+# define COLDLINES 1024
+#endif
+
 #ifdef NO_SECONDARY_SCREEN
 # define NSCREENS       0
 #else
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 1997-2009, Michael Jennings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of the Software, its documentation and marketing & publicity
+ * materials, and acknowledgment shall be given in the documentation, materials
+ * and software packages that this Software was used.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+static const char cvs_ident[] = "$Id$";
+
+#include "config.h"
+#include "feature.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+
+#include "loop.h"
+
+/* The descriptors cmd_getc() waits on, what it wants to know about each of them, and what
+   it found out from the last loop_wait().  There are only ever a handful. */
+static struct {
+    int fd;
+    unsigned char events, ready;
+} watched[LOOP_MAX_FDS];
+static int nwatched = 0;
+
+#ifdef HAVE_SYS_EPOLL_H
+/* -1 until the first loop_watch(); -2 if epoll is not available and poll() has to do. */
+static int epoll_fd = -1;
+
+static unsigned long
+loop_epoll_events(unsigned char events)
+{
+    return (((events & LOOP_READ) ? EPOLLIN : 0) | ((events & LOOP_WRITE) ? EPOLLOUT : 0));
+}
+
+static void
+loop_epoll_ctl(int op, int fd, unsigned char events)
+{
+    struct epoll_event ev;
+
+    if (epoll_fd == -1) {
+        if ((epoll_fd = epoll_create(LOOP_MAX_FDS)) < 0) {
+            D_CMD(("epoll_create() failed (%s); using poll().\n", strerror(errno)));
+            epoll_fd = -2;
+        } else {
+            /* Keep it out of the print pipe and anything else we start later. */
+            fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    if (epoll_fd < 0) {
+        return;
+    }
+    ev.events = loop_epoll_events(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, op, fd, &ev) < 0) {
+        D_CMD(("epoll_ctl(%d, %d) failed:  %s\n", op, fd, strerror(errno)));
+    }
+}
+#endif
+
+/* Wait for <events> on <fd> from now on, or stop watching it altogether if <events> is 0.
+   Calling this again with the same events is cheap. */
+void
+loop_watch(int fd, unsigned char events)
+{
+    register int i;
+
+    for (i = 0; i < nwatched && watched[i].fd != fd; i++);
+    if (i == nwatched) {
+        if (!events) {
+            return;
+        }
+        ASSERT(nwatched < LOOP_MAX_FDS);
+        watched[nwatched].fd = fd;
+        watched[nwatched].events = events;
+        watched[nwatched++].ready = 0;
+#ifdef HAVE_SYS_EPOLL_H
+        loop_epoll_ctl(EPOLL_CTL_ADD, fd, events);
+#endif
+    } else if (!events) {
+#ifdef HAVE_SYS_EPOLL_H
+        loop_epoll_ctl(EPOLL_CTL_DEL, fd, 0);
+#endif
+        watched[i] = watched[--nwatched];
+    } else if (events != watched[i].events) {
+        watched[i].events = events;
+#ifdef HAVE_SYS_EPOLL_H
+        loop_epoll_ctl(EPOLL_CTL_MOD, fd, events);
+#endif
+    }
+}
+
+/* Sleep until one of the watched descriptors is ready or <usec> microseconds pass.  A
+   negative <usec> means no timeout.  Returns what epoll_wait()/poll() did:  the number
+   of ready descriptors, 0 on timeout, or -1 with errno set. */
+int
+loop_wait(long usec)
+{
+    int msec = ((usec < 0) ? (-1) : ((usec + 999) / 1000));
+    register int i, n;
+
+    for (i = 0; i < nwatched; i++) {
+        watched[i].ready = 0;
+    }
+#ifdef HAVE_SYS_EPOLL_H
+    if (epoll_fd >= 0) {
+        struct epoll_event evs[LOOP_MAX_FDS];
+        int j;
+
+        n = epoll_wait(epoll_fd, evs, LOOP_MAX_FDS, msec);
+        for (j = 0; j < n; j++) {
+            for (i = 0; i < nwatched && watched[i].fd != evs[j].data.fd; i++);
+            if (i == nwatched) {
+                continue;
+            }
+            /* Hangups and errors show up as readable, so the read() finds out what happened. */
+            if (evs[j].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                watched[i].ready |= (watched[i].events & LOOP_READ);
+            }
+            if (evs[j].events & (EPOLLOUT | EPOLLERR)) {
+                watched[i].ready |= (watched[i].events & LOOP_WRITE);
+            }
+        }
+        return n;
+    }
+#endif
+    {
+        struct pollfd pfds[LOOP_MAX_FDS];
+
+        for (i = 0; i < nwatched; i++) {
+            pfds[i].fd = watched[i].fd;
+            pfds[i].events = (((watched[i].events & LOOP_READ) ? POLLIN : 0) | ((watched[i].events & LOOP_WRITE) ? POLLOUT : 0));
+            pfds[i].revents = 0;
+        }
+        n = poll(pfds, nwatched, msec);
+        for (i = 0; n > 0 && i < nwatched; i++) {
+            if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) {
+                watched[i].ready |= (watched[i].events & LOOP_READ);
+            }
+            if (pfds[i].revents & (POLLOUT | POLLERR | POLLNVAL)) {
+                watched[i].ready |= (watched[i].events & LOOP_WRITE);
+            }
+        }
+        return n;
+    }
+}
+
+/* Which of the events being watched for on <fd> the last loop_wait() reported. */
+unsigned char
+loop_ready(int fd)
+{
+    register int i;
+
+    for (i = 0; i < nwatched; i++) {
+        if (watched[i].fd == fd) {
+            return watched[i].ready;
+        }
+    }
+    return 0;
+}
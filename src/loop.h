@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 1997-2009, Michael Jennings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of the Software, its documentation and marketing & publicity
+ * materials, and acknowledgment shall be given in the documentation, materials
+ * and software packages that this Software was used.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOOP_H_
+#define _LOOP_H_
+
+#include <X11/Xfuncproto.h>
+
+/************ Macros and Definitions ************/
+#define LOOP_READ   (1 << 0)
+#define LOOP_WRITE  (1 << 1)
+
+#define LOOP_MAX_FDS  8
+
+/************ Variables ************/
+
+/************ Function Prototypes ************/
+_XFUNCPROTOBEGIN
+
+extern void loop_watch(int fd, unsigned char events);
+extern int loop_wait(long usec);
+extern unsigned char loop_ready(int fd);
+
+_XFUNCPROTOEND
+
+#endif	/* _LOOP_H_ */
@@ -110,6 +110,7 @@ char *rs_geometry = NULL;       /* Geometry string */
 int rs_desktop = -1;
 char *rs_path = NULL;
 int rs_saveLines = SAVELINES;   /* Lines in the scrollback buffer */
+int rs_coldLines = COLDLINES;   /* Scrollback lines kept unpacked */
 
 #ifdef USE_XIM
 char *rs_input_method = NULL;
@@ -125,6 +126,9 @@ char *rs_print_pipe = NULL;
 #endif
 char *rs_cutchars = NULL;
 unsigned short rs_min_anchor_size = 0;
+unsigned long rs_frame_rate = FRAME_RATE;
+unsigned long rs_max_latency = MAX_LATENCY;
+unsigned long rs_shade_threads = 0;
 char *rs_scrollbar_type = NULL;
 unsigned long rs_scrollbar_width = 0;
 char *rs_finished_title = NULL;
@@ -345,7 +349,11 @@ spifopt_t option_list[] = {
 
     /* =======[ Misc options ]======= */
     SPIFOPT_INT('L', "save-lines", "lines to save in scrollback buffer", rs_saveLines),
+    SPIFOPT_INT_LONG("cold-lines", "scrollback lines kept unpacked (0 to never pack)", rs_coldLines),
     SPIFOPT_INT_LONG("min-anchor-size", "minimum size of the scrollbar anchor", rs_min_anchor_size),
+    SPIFOPT_INT_LONG("frame-rate", "most screen updates per second (0 for no limit)", rs_frame_rate),
+    SPIFOPT_INT_LONG("max-latency", "most milliseconds the screen may lag behind output", rs_max_latency),
+    SPIFOPT_INT_LONG("shade-threads", "threads used to shade images (0 for one per processor)", rs_shade_threads),
 #ifdef BORDER_WIDTH_OPTION
     SPIFOPT_INT('w', "border-width", "term window border width", TermWin.internalBorder),
 #endif
@@ -726,10 +734,15 @@ version(void)
 #else
     printf(" -PATH_ENV\n");
 #endif
-#ifdef REFRESH_PERIOD
-    printf(" REFRESH_PERIOD=%d\n", REFRESH_PERIOD);
+#ifdef FRAME_RATE
+    printf(" FRAME_RATE=%d\n", FRAME_RATE);
 #else
-    printf(" -REFRESH_PERIOD\n");
+    printf(" -FRAME_RATE\n");
+#endif
+#ifdef MAX_LATENCY
+    printf(" MAX_LATENCY=%d\n", MAX_LATENCY);
+#else
+    printf(" -MAX_LATENCY\n");
 #endif
 #ifdef PRINTPIPE
     printf(" PRINTPIPE=\"%s\"\n", safe_print_string(PRINTPIPE, sizeof(PRINTPIPE) - 1));
@@ -1480,9 +1493,21 @@ parse_misc(char *buff, void *state)
     } else if (!BEG_STRCASECMP(buff, "save_lines ")) {
         rs_saveLines = strtol(spiftool_get_pword(2, buff), (char **) NULL, 0);
 
+    } else if (!BEG_STRCASECMP(buff, "cold_lines ")) {
+        rs_coldLines = strtol(spiftool_get_pword(2, buff), (char **) NULL, 0);
+
     } else if (!BEG_STRCASECMP(buff, "min_anchor_size ")) {
         rs_min_anchor_size = strtol(spiftool_get_pword(2, buff), (char **) NULL, 0);
 
+    } else if (!BEG_STRCASECMP(buff, "frame_rate ")) {
+        rs_frame_rate = strtoul(spiftool_get_pword(2, buff), (char **) NULL, 0);
+
+    } else if (!BEG_STRCASECMP(buff, "max_latency ")) {
+        rs_max_latency = strtoul(spiftool_get_pword(2, buff), (char **) NULL, 0);
+
+    } else if (!BEG_STRCASECMP(buff, "shade_threads ")) {
+        rs_shade_threads = strtoul(spiftool_get_pword(2, buff), (char **) NULL, 0);
+
     } else if (!BEG_STRCASECMP(buff, "border_width ")) {
 #ifdef BORDER_WIDTH_OPTION
         TermWin.internalBorder = (short) strtol(spiftool_get_pword(2, buff), (char **) NULL, 0);
@@ -2650,6 +2675,9 @@ post_parse(void)
     if ((TermWin.saveLines = rs_saveLines) < 0) {
         TermWin.saveLines = SAVELINES;
     }
+    if ((TermWin.coldLines = rs_coldLines) < 0) {
+        TermWin.coldLines = COLDLINES;
+    }
     /* no point having a scrollbar without having any scrollback! */
     if (!TermWin.saveLines) {
         BITFIELD_CLEAR(eterm_options, ETERM_OPTIONS_SCROLLBAR);
@@ -3885,7 +3913,11 @@ save_config(char *path, unsigned char save_theme)
     }
 #endif
     fprintf(fp, "    save_lines %d\n", rs_saveLines);
+    fprintf(fp, "    cold_lines %d\n", rs_coldLines);
     fprintf(fp, "    min_anchor_size %d\n", rs_min_anchor_size);
+    fprintf(fp, "    frame_rate %lu\n", rs_frame_rate);
+    fprintf(fp, "    max_latency %lu\n", rs_max_latency);
+    fprintf(fp, "    shade_threads %lu\n", rs_shade_threads);
     fprintf(fp, "    border_width %d\n", TermWin.internalBorder);
     fprintf(fp, "    term_name %s\n", getenv("TERM"));
     fprintf(fp, "    beep_command \"%s\"\n", (char *) ((rs_beep_command) ? (rs_beep_command) : ("")));
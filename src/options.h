@@ -100,7 +100,11 @@ extern       char  *rs_iconName;	/* Icon name */
 extern       char  *rs_geometry;	/* Geometry string */
 extern        int   rs_desktop;         /* Startup desktop */
 extern        int   rs_saveLines;	/* Lines in the scrollback buffer */
+extern        int   rs_coldLines;	/* Scrollback lines kept unpacked */
 extern unsigned short rs_min_anchor_size; /* Minimum size, in pixels, of the scrollbar anchor */
+extern unsigned long rs_frame_rate;	/* Most screen updates per second */
+extern unsigned long rs_max_latency;	/* Most milliseconds the screen may lag behind output */
+extern unsigned long rs_shade_threads;	/* Threads used to shade images, 0 for one per processor */
 extern       char  *rs_finished_title;	/* Text added to window title (--pause) */
 extern       char  *rs_finished_text;	/* Text added to scrollback (--pause) */
 extern       char  *rs_term_name;
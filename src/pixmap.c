@@ -37,8 +37,18 @@ static const char cvs_ident[] = "$Id$";
 # include <X11/Xutil.h>
 # include <X11/extensions/shape.h>
 #endif
+#ifdef HAVE_PTHREADS
+# include <pthread.h>
+# include <signal.h>
+#endif
+#ifdef HAVE_X_SHM_EXT
+# include <sys/ipc.h>
+# include <sys/shm.h>
+# include <X11/extensions/XShm.h>
+#endif
 
 #include "buttons.h"
+#include "cmod.h"
 #include "command.h"
 #include "draw.h"
 #include "e.h"
@@ -52,24 +62,6 @@ static const char cvs_ident[] = "$Id$";
 #include "term.h"
 #include "windows.h"
 
-/* FIXME:  Workaround for older versions of libast. */
-#ifndef WORDS_BIGENDIAN
-#  define WORDS_BIGENDIAN 0
-#endif
-
-/* Optimized check for rm, gm, and bm all < 256 */
-#define COLORMODS_HAVE_SATURATION(rm, gm, bm)  ((rm|gm|bm) >> 8)
-
-/* Assembler routines for 32 bit cpu with mmx */
-extern void shade_ximage_15_mmx(void *data, int bpl, int w, int h, int rm, int gm, int bm);
-extern void shade_ximage_16_mmx(void *data, int bpl, int w, int h, int rm, int gm, int bm);
-extern void shade_ximage_32_mmx(void *data, int bpl, int w, int h, int rm, int gm, int bm);
-
-/* Assembler routines for 64 bit cpu with sse2 */
-extern void shade_ximage_15_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
-extern void shade_ximage_16_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
-extern void shade_ximage_32_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm);
-
 #ifdef PIXMAP_SUPPORT
 static Imlib_Border bord_none = { 0, 0, 0, 0 };
 #endif
@@ -80,6 +72,7 @@ Pixmap buffer_pixmap = None;
 Pixmap desktop_pixmap = None, viewport_pixmap = None;
 Window desktop_window = None;
 unsigned char desktop_pixmap_is_mine = 0;
+static unsigned char desktop_pixmap_is_shared = 0;
 #endif
 
 image_t images[image_max] = {
@@ -439,6 +432,162 @@ simage_t *create_simage(void)
     return s;
 }
 
+/* Rendered pixmaps for the images that flip between states (scrollbar, buttons, menus) are
+   kept, most recently used first, up to RENDER_CACHE_SIZE bytes of pixmap memory on the
+   server.  Showing one of them again is then just a matter of making it the window's
+   background.  The key is everything render_simage() works from, and entries for an simage
+   are dropped whenever it's reset; all of them go when a color modifier changes. */
+typedef struct {
+    simage_t *simg;
+    Imlib_Image im;
+    Imlib_Border *border;
+    bevel_t *bevel;
+    unsigned short width, height, op;
+    short w, h, x, y;
+    unsigned short mods[4][3];
+} render_key_t;
+
+typedef struct render_cache_struct {
+    render_key_t key;
+    Pixmap pixmap, mask;
+    unsigned long size;
+    struct render_cache_struct *prev, *next;
+} render_cache_t;
+
+static render_cache_t *render_cache = NULL, *render_cache_tail = NULL;
+static unsigned long render_cache_bytes = 0;
+
+static void
+render_cache_key(render_key_t *key, simage_t *simg, unsigned short width, unsigned short height)
+{
+    colormod_t *mods[4];
+    unsigned char i;
+
+    memset(key, 0, sizeof(render_key_t));
+    key->simg = simg;
+    key->im = simg->iml->im;
+    key->border = simg->iml->border;
+    key->bevel = simg->iml->bevel;
+    key->width = width;
+    key->height = height;
+    key->op = simg->pmap->op;
+    key->w = simg->pmap->w;
+    key->h = simg->pmap->h;
+    key->x = simg->pmap->x;
+    key->y = simg->pmap->y;
+    mods[0] = simg->iml->mod;
+    mods[1] = simg->iml->rmod;
+    mods[2] = simg->iml->gmod;
+    mods[3] = simg->iml->bmod;
+    for (i = 0; i < 4; i++) {
+        if (mods[i]) {
+            key->mods[i][0] = mods[i]->brightness;
+            key->mods[i][1] = mods[i]->contrast;
+            key->mods[i][2] = mods[i]->gamma;
+        }
+    }
+}
+
+static void
+render_cache_unlink(render_cache_t *ent)
+{
+    if (ent->prev) {
+        ent->prev->next = ent->next;
+    } else {
+        render_cache = ent->next;
+    }
+    if (ent->next) {
+        ent->next->prev = ent->prev;
+    } else {
+        render_cache_tail = ent->prev;
+    }
+}
+
+static void
+render_cache_push(render_cache_t *ent)
+{
+    ent->prev = NULL;
+    ent->next = render_cache;
+    if (render_cache) {
+        render_cache->prev = ent;
+    } else {
+        render_cache_tail = ent;
+    }
+    render_cache = ent;
+}
+
+static void
+render_cache_drop(render_cache_t *ent)
+{
+    render_cache_unlink(ent);
+    render_cache_bytes -= ent->size;
+    IMLIB_FREE_PIXMAP(ent->pixmap);
+    FREE(ent);
+}
+
+/* Forget the pixmaps rendered for simg, or all of them if it's NULL. */
+static void
+render_cache_flush(simage_t *simg)
+{
+    render_cache_t *ent, *next;
+
+    for (ent = render_cache; ent; ent = next) {
+        next = ent->next;
+        if (!simg || ent->key.simg == simg) {
+            render_cache_drop(ent);
+        }
+    }
+}
+
+/* Look for simg at width x height, and move it to the front if it's there. */
+static render_cache_t *
+render_cache_find(simage_t *simg, unsigned short width, unsigned short height)
+{
+    render_key_t key;
+    render_cache_t *ent;
+
+    render_cache_key(&key, simg, width, height);
+    for (ent = render_cache; ent; ent = ent->next) {
+        if (!memcmp(&ent->key, &key, sizeof(render_key_t))) {
+            render_cache_unlink(ent);
+            render_cache_push(ent);
+            return ent;
+        }
+    }
+    return NULL;
+}
+
+/* Hand pixmap (and mask) for simg at width x height over to the cache.  Returns 0, leaving
+   them to the caller, if they're too big to be worth keeping. */
+static unsigned char
+render_cache_add(simage_t *simg, unsigned short width, unsigned short height, Pixmap pixmap, Pixmap mask)
+{
+    render_cache_t *ent;
+    unsigned long size;
+
+    size = (unsigned long) width * height * ((Xdepth > 16) ? 4 : ((Xdepth > 8) ? 2 : 1));
+    if (mask != None) {
+        size += (unsigned long) ((width + 7) / 8) * height;
+    }
+    if (size > RENDER_CACHE_SIZE / 4) {
+        return 0;
+    }
+    while (render_cache_tail && render_cache_bytes + size > RENDER_CACHE_SIZE) {
+        D_PIXMAP(("Evicting rendered pixmap 0x%08x (%lu bytes).\n", render_cache_tail->pixmap, render_cache_tail->size));
+        render_cache_drop(render_cache_tail);
+    }
+    ent = (render_cache_t *) MALLOC(sizeof(render_cache_t));
+    render_cache_key(&ent->key, simg, width, height);
+    ent->pixmap = pixmap;
+    ent->mask = mask;
+    ent->size = size;
+    render_cache_push(ent);
+    render_cache_bytes += size;
+    D_PIXMAP(("Cached rendered pixmap 0x%08x for %8p at %hux%hu; %lu bytes in use.\n", pixmap, simg, width, height,
+              render_cache_bytes));
+    return 1;
+}
+
 void
 reset_simage(simage_t *simg, unsigned long mask)
 {
@@ -446,6 +595,7 @@ reset_simage(simage_t *simg, unsigned long mask)
     ASSERT(simg != NULL);
 
     D_PIXMAP(("reset_simage(%8p, 0x%08x)\n", simg, mask));
+    render_cache_flush(simg);
 
     if ((mask & RESET_PMAP_PIXMAP) && simg->pmap->pixmap != None) {
         IMLIB_FREE_PIXMAP(simg->pmap->pixmap);
@@ -660,8 +810,9 @@ create_trans_pixmap(simage_t *simg, unsigned char which, Drawable d, int x, int
     int pw, ph;
     Window dummy;
     Screen *scr;
-    Pixmap p = None;
+    Pixmap p = None, tile;
     GC gc;
+    unsigned char shade;
 
     D_PIXMAP(("create_trans_pixmap(%8p, 0x%08x, %u, %d, %d, %hu, %hu) called.\n", simg, d, which, x, y, width, height));
     scr = ScreenOfDisplay(Xdisplay, Xscreen);
@@ -686,14 +837,23 @@ create_trans_pixmap(simage_t *simg, unsigned char which, Drawable d, int x, int
     D_PIXMAP(("Created p [0x%08x] as a %hux%hu pixmap at %d, %d relative to window 0x%08x\n", p, width, height, x, y,
               desktop_window));
     if (p != None) {
-        D_PIXMAP(("Tiling %ux%u desktop pixmap 0x%08x onto p.\n", pw, ph, desktop_pixmap));
-        XSetTile(Xdisplay, gc, desktop_pixmap);
+        /* Unless we're told the window won't be moving, tile from a desktop pixmap that's been
+           shaded already, so that moves only need the server to redraw from it. */
+        shade = ((which != image_bg || (BITFIELD_IS_SET(image_options, IMAGE_OPTIONS_ITRANS))
+                  || images[image_bg].current != images[image_bg].norm)
+                 && need_colormod(simg->iml));
+        if (shade && !(BITFIELD_IS_SET(image_options, IMAGE_OPTIONS_ITRANS))
+            && (tile = get_shaded_desktop_pixmap(simg->iml, pw, ph)) != None) {
+            shade = 0;
+        } else {
+            tile = desktop_pixmap;
+        }
+        D_PIXMAP(("Tiling %ux%u desktop pixmap 0x%08x onto p.\n", pw, ph, tile));
+        XSetTile(Xdisplay, gc, tile);
         XSetTSOrigin(Xdisplay, gc, pw - (x % pw), ph - (y % ph));
         XSetFillStyle(Xdisplay, gc, FillTiled);
         XFillRectangle(Xdisplay, p, gc, 0, 0, width, height);
-        if ((which != image_bg || (BITFIELD_IS_SET(image_options, IMAGE_OPTIONS_ITRANS))
-             || images[image_bg].current != images[image_bg].norm)
-            && need_colormod(simg->iml)) {
+        if (shade) {
             colormod_trans(p, simg->iml, gc, width, height);
         }
         if (simg->iml->bevel) {
@@ -1153,7 +1313,26 @@ render_simage(simage_t *simg, Window win, unsigned short width, unsigned short h
     }
 # endif
     if (image_mode_is(which, MODE_IMAGE) && image_mode_is(which, ALLOW_IMAGE)) {
-        if (simg->iml->im) {
+        render_cache_t *cached = NULL;
+
+        if (simg->iml->im && which != image_bg && (cached = render_cache_find(simg, width, height))) {
+            D_PIXMAP(("Using cached pixmap 0x%08x for window 0x%08x\n", cached->pixmap, win));
+            if (pixmap != None) {
+                IMLIB_FREE_PIXMAP(pixmap);
+                simg->pmap->pixmap = None;
+            }
+            if (cached->mask != None) {
+                shaped_window_apply_mask(win, cached->mask);
+            }
+            if (renderop & RENDER_FORCE_PIXMAP) {
+                simg->pmap->pixmap = LIBAST_X_CREATE_PIXMAP(width, height);
+                XCopyArea(Xdisplay, cached->pixmap, simg->pmap->pixmap, gc, 0, 0, width, height, 0, 0);
+                XSetWindowBackgroundPixmap(Xdisplay, win, simg->pmap->pixmap);
+            } else {
+                XSetWindowBackgroundPixmap(Xdisplay, win, cached->pixmap);
+            }
+        } else if (simg->iml->im) {
+            Pixmap mask = None;
             int w = simg->pmap->w;
             int h = simg->pmap->h;
             int x = simg->pmap->x;
@@ -1250,6 +1429,7 @@ render_simage(simage_t *simg, Window win, unsigned short width, unsigned short h
                     IMLIB_FREE_PIXMAP(pixmap);
                 } else {
                     shaped_window_apply_mask(win, simg->pmap->mask);
+                    mask = simg->pmap->mask;
                 }
                 if (simg->iml->bevel) {
                     bevel_pixmap(simg->pmap->pixmap, width, height, simg->iml->bevel->edges, simg->iml->bevel->up);
@@ -1262,7 +1442,16 @@ render_simage(simage_t *simg, Window win, unsigned short width, unsigned short h
                     /* FIXME:  For efficiency, just fill the window with the pixmap
                        and handle exposes by copying from simg->pmap->pixmap. */
                     XSetWindowBackgroundPixmap(Xdisplay, win, simg->pmap->pixmap);
-                    if (!(renderop & RENDER_FORCE_PIXMAP)) {
+                    if (which != image_bg && render_cache_add(simg, width, height, simg->pmap->pixmap, mask)) {
+                        /* The cache owns it now; anyone who wants to hang onto a pixmap gets a copy. */
+                        if (renderop & RENDER_FORCE_PIXMAP) {
+                            pixmap = simg->pmap->pixmap;
+                            simg->pmap->pixmap = LIBAST_X_CREATE_PIXMAP(width, height);
+                            XCopyArea(Xdisplay, pixmap, simg->pmap->pixmap, gc, 0, 0, width, height, 0, 0);
+                        } else {
+                            simg->pmap->pixmap = None;
+                        }
+                    } else if (!(renderop & RENDER_FORCE_PIXMAP)) {
                         IMLIB_FREE_PIXMAP(simg->pmap->pixmap);
                         simg->pmap->pixmap = None;
                     }
@@ -1496,6 +1685,7 @@ update_cmod_tables(imlib_t *iml)
     DATA8 rt[256], gt[256], bt[256];
 
     REQUIRE(mod || rmod || gmod || bmod);
+    render_cache_flush(NULL);
     /* When any changes is made to any individual color modifier for an image,
        this function must be called to update the overall Imlib2 color modifier. */
     D_PIXMAP(("Updating color modifier tables for %8p\n", iml));
@@ -1551,143 +1741,6 @@ need_colormod(register imlib_t *iml)
 
 /* New optimized routines for tinting XImages written by Willem Monsuwe <willem@stack.nl> */
 
-#if !defined HAVE_MMX && !defined HAVE_SSE2
-/* RGB 15 */
-static void
-shade_ximage_15(void *data, int bpl, int w, int h, int rm, int gm, int bm)
-{
-    unsigned char *ptr;
-    int x, y;
-
-    ptr = (unsigned char *) data + (w * sizeof(DATA16));
-    if (!COLORMODS_HAVE_SATURATION(rm, gm, bm)) {
-        /* No saturation */
-        for (y = h; --y >= 0;) {
-            for (x = -w; x < 0; x++) {
-                int r, g, b;
-
-                b = ((DATA16 *) ptr)[x];
-                r = (b & 0x7c00) * rm;
-                g = (b & 0x3e0) * gm;
-                b = (b & 0x1f) * bm;
-                ((DATA16 *) ptr)[x] = ((r >> 8) & 0x7c00)
-                    | ((g >> 8) & 0x3e0)
-                    | ((b >> 8) & 0x1f);
-            }
-            ptr += bpl;
-        }
-    } else {
-        for (y = h; --y >= 0;) {
-            for (x = -w; x < 0; x++) {
-                int r, g, b;
-
-                b = ((DATA16 *) ptr)[x];
-                r = (((b >> 10) & 0x001f ) * rm) >> 8;
-                r = (r > 0x001f) ? 0x7c00 : (r << 10);
-                g = (((b >>  5) & 0x001f ) * gm) >> 8;
-                g = (g > 0x001f) ? 0x03e0 : (g << 5);
-                b = (((b >>  0) & 0x001f ) * bm) >> 8;
-                b = (b > 0x001f) ? 0x001f : (b << 0);
-                ((DATA16 *) ptr)[x] = (r|g|b);
-            }
-            ptr += bpl;
-        }
-    }
-}
-
-/* RGB 16 */
-static void
-shade_ximage_16(void *data, int bpl, int w, int h, int rm, int gm, int bm)
-{
-    unsigned char *ptr;
-    int x, y;
-
-    ptr = (unsigned char *) data + (w * sizeof(DATA16));
-    if (!COLORMODS_HAVE_SATURATION(rm, gm, bm)) {
-        /* No saturation */
-        for (y = h; --y >= 0;) {
-            for (x = -w; x < 0; x++) {
-                int r, g, b;
-
-                b = ((DATA16 *) ptr)[x];
-                r = (b & 0xf800) * rm;
-                g = (b & 0x7e0) * gm;
-                b = (b & 0x1f) * bm;
-                ((DATA16 *) ptr)[x] = ((r >> 8) & 0xf800)
-                    | ((g >> 8) & 0x7e0)
-                    | ((b >> 8) & 0x1f);
-            }
-            ptr += bpl;
-        }
-    } else {
-        for (y = h; --y >= 0;) {
-            for (x = -w; x < 0; x++) {
-                int r, g, b;
-
-                b = ((DATA16 *) ptr)[x];
-                r = (((b >> 11) & 0x001f) * rm) >> 8;
-		r = (r > 0x001f) ? 0xf800 : (r << 11);
-                g = (((b >>  5) & 0x003f) * gm) >> 8;
-		g = (g > 0x003f) ? 0x07e0 : (g << 5);
-                b = (((b >>  0) & 0x001f) * bm) >> 8;
-		b = (b > 0x001f) ? 0x001f : (b << 0);
-                ((DATA16 *) ptr)[x] = (r|g|b);
-            }
-            ptr += bpl;
-        }
-    }
-}
-
-/* RGB 32 */
-static void
-shade_ximage_32(void *data, int bpl, int w, int h, int rm, int gm, int bm)
-{
-    unsigned char *ptr;
-    int x, y;
-
-    ptr = (unsigned char *) data + (w * 4);
-    if (!COLORMODS_HAVE_SATURATION(rm, gm, bm)) {
-        /* No saturation */
-        for (y = h; --y >= 0;) {
-            for (x = -(w * 4); x < 0; x += 4) {
-# if WORDS_BIGENDIAN
-                ptr[x + 1] = ((ptr[x + 1] * rm) >> 8);
-                ptr[x + 2] = ((ptr[x + 2] * gm) >> 8);
-                ptr[x + 3] = ((ptr[x + 3] * bm) >> 8);
-# else
-                ptr[x + 2] = ((ptr[x + 2] * rm) >> 8);
-                ptr[x + 1] = ((ptr[x + 1] * gm) >> 8);
-                ptr[x + 0] = ((ptr[x + 0] * bm) >> 8);
-# endif
-            }
-            ptr += bpl;
-        }
-    } else {
-        for (y = h; --y >= 0;) {
-            for (x = -(w * 4); x < 0; x += 4) {
-                int r, g, b;
-# if WORDS_BIGENDIAN
-                r = (ptr[x + 1] * rm) >> 8;
-                ptr[x + 1] = r|(!(r >> 8) - 1);
-                g = (ptr[x + 2] * gm) >> 8;
-                ptr[x + 2] = g|(!(g >> 8) - 1);
-                b = (ptr[x + 3] * bm) >> 8;
-                ptr[x + 3] = b|(!(b >> 8) - 1);
-# else
-                r = (ptr[x + 2] * rm) >> 8;
-                ptr[x + 2] = r|(!(r >> 8) - 1);
-                g = (ptr[x + 1] * gm) >> 8;
-                ptr[x + 1] = g|(!(g >> 8) - 1);
-                b = (ptr[x + 0] * bm) >> 8;
-                ptr[x + 0] = b|(!(b >> 8) - 1);
-# endif
-            }
-            ptr += bpl;
-        }
-    }
-}
-#endif
-
 /* RGB 24 */
 static void
 shade_ximage_24(void *data, int bpl, int w, int h, int rm, int gm, int bm)
@@ -1739,50 +1792,364 @@ shade_ximage_24(void *data, int bpl, int w, int h, int rm, int gm, int bm)
 }
 
 #  ifdef PIXMAP_OFFSET
-void
-colormod_trans(Pixmap p, imlib_t *iml, GC gc, unsigned short w, unsigned short h)
+/* For requests that are allowed to fail:  errors between x_trap_errors() and x_untrap_errors()
+   only set x_error_trapped instead of going to xerror_handler(). */
+static XErrorHandler x_trap_old_handler;
+static unsigned char x_error_trapped = 0;
+
+static int
+x_trap_error_handler(Display * d, XErrorEvent * ev)
+{
+    USE_VAR(d);
+    USE_VAR(ev);
+    x_error_trapped = 1;
+    return 0;
+}
+
+static void
+x_trap_errors(void)
+{
+    x_error_trapped = 0;
+    x_trap_old_handler = XSetErrorHandler((XErrorHandler) x_trap_error_handler);
+}
+
+/* Stop trapping.  Returns 1 if anything failed since x_trap_errors(). */
+static unsigned char
+x_untrap_errors(void)
+{
+    XSync(Xdisplay, False);
+    XSetErrorHandler(x_trap_old_handler);
+    return x_error_trapped;
+}
+
+#   ifdef HAVE_X_SHM_EXT
+/* colormod_trans() round-trips the pixels through one shared memory segment when it can,
+   instead of through the X socket.  The segment is kept and grown to fit the largest
+   pixmap shaded so far.  shm_state is 0 until the extension has been checked for, 1 if
+   it's usable, and -1 if it isn't (remote display, no extension, attach refused). */
+static XShmSegmentInfo shm_info;
+static size_t shm_size = 0;
+static signed char shm_state = 0;
+
+/* Drop the segment we have, if any. */
+static void
+shm_release(void)
+{
+    if (shm_size) {
+        XShmDetach(Xdisplay, &shm_info);
+        XSync(Xdisplay, False);
+        shmdt(shm_info.shmaddr);
+        shm_size = 0;
+    }
+}
+
+/* Make sure the segment holds at least size bytes.  Returns 0 if shared memory can't be used. */
+static unsigned char
+shm_reserve(size_t size)
+{
+    unsigned char failed;
+
+    if (!shm_state) {
+        shm_state = (XShmQueryExtension(Xdisplay) ? 1 : -1);
+        D_PIXMAP(("MIT-SHM extension is %savailable.\n", ((shm_state > 0) ? "" : "not ")));
+    }
+    if (shm_state < 0) {
+        return 0;
+    } else if (size <= shm_size) {
+        return 1;
+    }
+    shm_release();
+
+    shm_info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shm_info.shmid < 0) {
+        D_PIXMAP(("shmget() for %lu bytes failed:  %s\n", (unsigned long) size, strerror(errno)));
+        return 0;
+    }
+    shm_info.shmaddr = (char *) shmat(shm_info.shmid, NULL, 0);
+    if (shm_info.shmaddr == (char *) -1) {
+        D_PIXMAP(("shmat() failed:  %s\n", strerror(errno)));
+        shmctl(shm_info.shmid, IPC_RMID, NULL);
+        return 0;
+    }
+    shm_info.readOnly = False;
+
+    /* The server can refuse to attach (a remote display, for one), and that only shows up as an error. */
+    x_trap_errors();
+    XShmAttach(Xdisplay, &shm_info);
+    failed = x_untrap_errors();
+
+    /* Either way, the segment goes away once the last of us lets go of it. */
+    shmctl(shm_info.shmid, IPC_RMID, NULL);
+    if (failed) {
+        D_PIXMAP(("XShmAttach() failed; not using MIT-SHM.\n"));
+        shmdt(shm_info.shmaddr);
+        shm_state = -1;
+        return 0;
+    }
+    D_PIXMAP(("Attached %lu-byte shared memory segment 0x%08x.\n", (unsigned long) size, (int) shm_info.shmseg));
+    shm_size = size;
+    return 1;
+}
+
+/* Fetch a w x h pixmap into the shared segment.  Returns NULL if that can't be done. */
+static XImage *
+shm_get_image(Pixmap p, unsigned short w, unsigned short h)
 {
     XImage *ximg;
-    register unsigned long i;
 
-#if 0
-    register unsigned long v;
-    unsigned long x, y;
-    int r, g, b;
-    register int br, bg, bb;
-    register unsigned int mr, mg, mb;
-#endif
-    unsigned short rm, gm, bm, shade;
-    Imlib_Color ctab[256];
-    int real_depth = 0;
+    if (shm_state < 0) {
+        return NULL;
+    }
+    ximg = XShmCreateImage(Xdisplay, Xvisual, Xdepth, ZPixmap, NULL, &shm_info, w, h);
+    if (!ximg) {
+        return NULL;
+    }
+    if (!shm_reserve(ximg->bytes_per_line * ximg->height)) {
+        XDestroyImage(ximg);
+        return NULL;
+    }
+    ximg->data = shm_info.shmaddr;
+    ximg->obdata = (char *) &shm_info;
+    if (!XShmGetImage(Xdisplay, p, ximg, 0, 0, AllPlanes)) {
+        D_PIXMAP(("XShmGetImage(Xdisplay, 0x%08x, ...) failed.\n", p));
+        ximg->data = NULL;
+        XDestroyImage(ximg);
+        return NULL;
+    }
+    return ximg;
+}
+#   endif
+
+typedef void (*shade_func_t) (void *, int, int, int, int, int, int);
+
+#   ifdef HAVE_PTHREADS
+/* Big images are shaded in horizontal bands, shared between the caller and a small pool of
+   worker threads that sleep until there's an image to do.  rs_shade_threads says how many
+   threads in all (0 for one per processor); the pool is started the first time it's needed. */
+#    define SHADE_MAX_THREADS   32
+#    define SHADE_MIN_ROWS      32      /* not worth a band of its own below this */
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+    int nthreads;               /* workers, not counting the caller; -1 before the pool is started */
+    shade_func_t func;
+    unsigned char *data;
+    int bpl, w, h, rm, gm, bm;
+    int nbands, next_band, pending;
+} shade_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, -1 };
+
+/* Shade band number <band> of the current image.  Called without the lock held. */
+static void
+shade_band(int band)
+{
+    int y1 = shade_pool.h * band / shade_pool.nbands, y2 = shade_pool.h * (band + 1) / shade_pool.nbands;
+
+    (shade_pool.func) (shade_pool.data + y1 * shade_pool.bpl, shade_pool.bpl, shade_pool.w, y2 - y1,
+                       shade_pool.rm, shade_pool.gm, shade_pool.bm);
+}
+
+/* Take bands until there are none left; returns with the lock held. */
+static void
+shade_take_bands(void)
+{
+    int band;
+
+    while (shade_pool.next_band < shade_pool.nbands) {
+        band = shade_pool.next_band++;
+        pthread_mutex_unlock(&shade_pool.lock);
+        shade_band(band);
+        pthread_mutex_lock(&shade_pool.lock);
+        if (--shade_pool.pending == 0) {
+            pthread_cond_signal(&shade_pool.done);
+        }
+    }
+}
+
+static void *
+shade_worker(void *arg)
+{
+    pthread_mutex_lock(&shade_pool.lock);
+    for (;;) {
+        while (shade_pool.next_band >= shade_pool.nbands) {
+            pthread_cond_wait(&shade_pool.work, &shade_pool.lock);
+        }
+        shade_take_bands();
+    }
+    return arg;
+}
+
+/* Start the worker threads.  Returns how many there are. */
+static int
+shade_pool_start(void)
+{
+    pthread_t thread;
+    sigset_t all, old;
+    long n;
+    int err;
+
+    if (shade_pool.nthreads >= 0) {
+        return shade_pool.nthreads;
+    }
+    n = (long) rs_shade_threads;
+    if (!n) {
+#     ifdef _SC_NPROCESSORS_ONLN
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+#     endif
+    }
+    BOUND(n, 1, SHADE_MAX_THREADS);
+
+    /* Signals are for the main thread; the workers inherit a mask that blocks them all. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (shade_pool.nthreads = 0; shade_pool.nthreads < n - 1; shade_pool.nthreads++) {
+        if ((err = pthread_create(&thread, NULL, shade_worker, NULL)) != 0) {
+            libast_print_warning("Unable to start image shading thread:  %s\n", strerror(err));
+            break;
+        }
+        pthread_detach(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    D_PIXMAP(("Shading images with %d worker thread(s).\n", shade_pool.nthreads));
+    return shade_pool.nthreads;
+}
+#   endif
+
+/* The kernels colormod_trans() uses for 15, 16, and 32 bpp.  With HAVE_CPU_DISPATCH they're
+   picked the first time through, from whatever the cpu says it supports; otherwise they're
+   fixed by configure. */
+static shade_func_t shade_func_15 = NULL, shade_func_16 = NULL, shade_func_32 = NULL;
+
+static void
+shade_kernels_select(void)
+{
+    if (shade_func_15) {
+        return;
+    }
+#   ifdef HAVE_CPU_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        shade_func_15 = shade_ximage_15_avx2;
+        shade_func_16 = shade_ximage_16_avx2;
+        shade_func_32 = shade_ximage_32_avx2;
+        D_PIXMAP(("Using AVX2 shading routines.\n"));
+    } else if (__builtin_cpu_supports("sse2")) {
+        shade_func_15 = shade_ximage_15_sse2;
+        shade_func_16 = shade_ximage_16_sse2;
+        shade_func_32 = shade_ximage_32_sse2;
+        D_PIXMAP(("Using SSE2 shading routines.\n"));
+    } else {
+        shade_func_15 = shade_ximage_15;
+        shade_func_16 = shade_ximage_16;
+        shade_func_32 = shade_ximage_32;
+        D_PIXMAP(("Using C shading routines.\n"));
+    }
+#   elif defined HAVE_SSE2
+    shade_func_15 = shade_ximage_15_sse2;
+    shade_func_16 = shade_ximage_16_sse2;
+    shade_func_32 = shade_ximage_32_sse2;
+    D_PIXMAP(("Using SSE2 shading routines.\n"));
+#   elif defined HAVE_MMX
+    shade_func_15 = shade_ximage_15_mmx;
+    shade_func_16 = shade_ximage_16_mmx;
+    shade_func_32 = shade_ximage_32_mmx;
+    D_PIXMAP(("Using MMX shading routines.\n"));
+#   else
+    shade_func_15 = shade_ximage_15;
+    shade_func_16 = shade_ximage_16;
+    shade_func_32 = shade_ximage_32;
+    D_PIXMAP(("Using C shading routines.\n"));
+#   endif
+}
+
+/* Run a shading kernel over a w x h image, in parallel bands if it's big enough to be worth it. */
+static void
+shade_ximage(shade_func_t func, void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+#   ifdef HAVE_PTHREADS
+    int nbands;
+
+    if (h >= 2 * SHADE_MIN_ROWS && shade_pool_start() > 0) {
+        nbands = MIN(shade_pool.nthreads + 1, h / SHADE_MIN_ROWS);
+        pthread_mutex_lock(&shade_pool.lock);
+        shade_pool.func = func;
+        shade_pool.data = (unsigned char *) data;
+        shade_pool.bpl = bpl;
+        shade_pool.w = w;
+        shade_pool.h = h;
+        shade_pool.rm = rm;
+        shade_pool.gm = gm;
+        shade_pool.bm = bm;
+        shade_pool.nbands = shade_pool.pending = nbands;
+        shade_pool.next_band = 0;
+        pthread_cond_broadcast(&shade_pool.work);
+
+        /* Do our share, then wait for the bands the workers took. */
+        shade_take_bands();
+        while (shade_pool.pending) {
+            pthread_cond_wait(&shade_pool.done, &shade_pool.lock);
+        }
+        pthread_mutex_unlock(&shade_pool.lock);
+        return;
+    }
+#   endif
+    (func) (data, bpl, w, h, rm, gm, bm);
+}
+
+/* The per-channel multipliers colormod_trans() applies for iml. */
+static void
+colormod_trans_mods(imlib_t *iml, unsigned short *rm, unsigned short *gm, unsigned short *bm)
+{
+    unsigned short shade;
 
-    D_PIXMAP(("colormod_trans(p == 0x%08x, gc, w == %hu, h == %hu) called.\n", p, w, h));
-    REQUIRE(p != None);
     if (iml->mod) {
         shade = iml->mod->brightness;
     } else {
         shade = 256;
     }
     if (iml->rmod) {
-        rm = (iml->rmod->brightness * shade) >> 8;
+        *rm = (iml->rmod->brightness * shade) >> 8;
     } else {
-        rm = shade;
+        *rm = shade;
     }
     if (iml->gmod) {
-        gm = (iml->gmod->brightness * shade) >> 8;
+        *gm = (iml->gmod->brightness * shade) >> 8;
     } else {
-        gm = shade;
+        *gm = shade;
     }
     if (iml->bmod) {
-        bm = (iml->bmod->brightness * shade) >> 8;
+        *bm = (iml->bmod->brightness * shade) >> 8;
     } else {
-        bm = shade;
+        *bm = shade;
     }
+}
+
+void
+colormod_trans(Pixmap p, imlib_t *iml, GC gc, unsigned short w, unsigned short h)
+{
+    XImage *ximg;
+    unsigned char shm = 0;
+    register unsigned long i;
+
+#if 0
+    register unsigned long v;
+    unsigned long x, y;
+    int r, g, b;
+    register int br, bg, bb;
+    register unsigned int mr, mg, mb;
+#endif
+    unsigned short rm, gm, bm;
+    Imlib_Color ctab[256];
+    int real_depth = 0;
+
+    D_PIXMAP(("colormod_trans(p == 0x%08x, gc, w == %hu, h == %hu) called.\n", p, w, h));
+    REQUIRE(p != None);
+    colormod_trans_mods(iml, &rm, &gm, &bm);
 
     if (rm == 256 && gm == 256 && bm == 256) {
         return;                 /* Nothing to do */
     }
-    D_PIXMAP((" -> rm == %hu, gm == %hu, bm == %hu, shade == %hu\n", rm, gm, bm, shade));
+    D_PIXMAP((" -> rm == %hu, gm == %hu, bm == %hu\n", rm, gm, bm));
     if (Xdepth <= 8) {
 
         XColor cols[256];
@@ -1809,12 +2176,20 @@ colormod_trans(Pixmap p, imlib_t *iml, GC gc, unsigned short w, unsigned short h
     if (!real_depth) {
         real_depth = Xdepth;
     }
-    ximg = XGetImage(Xdisplay, p, 0, 0, w, h, -1, ZPixmap);
-    if (!ximg) {
-        libast_print_warning("XGetImage(Xdisplay, 0x%08x, 0, 0, %d, %d, -1, ZPixmap) returned NULL.\n", p, w, h);
-        return;
+#ifdef HAVE_X_SHM_EXT
+    if ((ximg = shm_get_image(p, w, h))) {
+        D_PIXMAP(("XShmGetImage(Xdisplay, 0x%08x, %d, %d) into shared segment 0x%08x.\n", p, w, h, (int) shm_info.shmseg));
+        shm = 1;
+    } else
+#endif
+    {
+        ximg = XGetImage(Xdisplay, p, 0, 0, w, h, -1, ZPixmap);
+        if (!ximg) {
+            libast_print_warning("XGetImage(Xdisplay, 0x%08x, 0, 0, %d, %d, -1, ZPixmap) returned NULL.\n", p, w, h);
+            return;
+        }
+        D_PIXMAP(("XGetImage(Xdisplay, 0x%08x, 0, 0, %d, %d, -1, ZPixmap) returned %8p.\n", p, w, h, ximg));
     }
-    D_PIXMAP(("XGetImage(Xdisplay, 0x%08x, 0, 0, %d, %d, -1, ZPixmap) returned %8p.\n", p, w, h, ximg));
     if (Xdepth <= 8) {
 #if FIXME_BLOCK
         D_PIXMAP(("Rendering low-depth image, depth == %d\n", (int) Xdepth));
@@ -1844,60 +2219,250 @@ colormod_trans(Pixmap p, imlib_t *iml, GC gc, unsigned short w, unsigned short h
                 bm = tmp;
             }
         }
+        shade_kernels_select();
         /* Determine bitshift and bitmask values */
         switch (real_depth) {
             case 15:
-#ifdef HAVE_SSE2
-                D_PIXMAP(("Using SSE2 - 15 bit\n"));
-                shade_ximage_15_sse2(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#elif defined HAVE_MMX
-                D_PIXMAP(("Using MMX - 15 bit\n"));
-                shade_ximage_15_mmx(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#else
-                D_PIXMAP(("No MMX Found - 15 bit\n"));
-                shade_ximage_15(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#endif
+                D_PIXMAP(("Rendering 15 bit\n"));
+                shade_ximage(shade_func_15, ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
                 break;
             case 16:
-#ifdef HAVE_SSE2
-                D_PIXMAP(("Using SSE2 - 16 bit\n"));
-                shade_ximage_16_sse2(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#elif defined HAVE_MMX
-                D_PIXMAP(("Using MMX - 16 bit\n"));
-                shade_ximage_16_mmx(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#else
-                D_PIXMAP(("No MMX Found - 16 bit\n"));
-                shade_ximage_16(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#endif
+                D_PIXMAP(("Rendering 16 bit\n"));
+                shade_ximage(shade_func_16, ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
                 break;
             case 24:
                 if (ximg->bits_per_pixel != 32) {
                     D_PIXMAP(("Rendering 24 bit\n"));
-                    shade_ximage_24(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
+                    shade_ximage(shade_ximage_24, ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
                     break;
                 }
                 /* drop */
             case 32:
-#ifdef HAVE_SSE2
-                D_PIXMAP(("Using SSE2 - 32 bit\n"));
-                shade_ximage_32_sse2(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#elif defined HAVE_MMX
-                D_PIXMAP(("Using MMX - 32 bit\n"));
-                shade_ximage_32_mmx(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#else
-                D_PIXMAP(("No MMX Found - 32 bit\n"));
-                shade_ximage_32(ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
-#endif
+                D_PIXMAP(("Rendering 32 bit\n"));
+                shade_ximage(shade_func_32, ximg->data, ximg->bytes_per_line, w, h, rm, gm, bm);
                 break;
             default:
                 libast_print_warning("Bit depth of %d is unsupported for tinting/shading.\n", real_depth);
+                if (shm) {
+                    ximg->data = NULL;
+                }
+                XDestroyImage(ximg);
                 return;
         }
     }
+#ifdef HAVE_X_SHM_EXT
+    if (shm) {
+        /* The server reads the segment in request order, so the next XShmGetImage()
+           can't overwrite it before this is done. */
+        XShmPutImage(Xdisplay, p, gc, ximg, 0, 0, 0, 0, w, h, False);
+        ximg->data = NULL;
+        XDestroyImage(ximg);
+        return;
+    }
+#endif
     XPutImage(Xdisplay, p, gc, ximg, 0, 0, 0, 0, w, h);
     XDestroyImage(ximg);
 }
 
+
+/* Shaded copies of the desktop pixmap are shared between Eterms through a list on the root
+   window, SHADE_CACHE_FIELDS CARD32s per entry.  The first Eterm to need a given source pixmap,
+   size, and set of multipliers shades a pixmap created on a throwaway connection that's closed
+   with RetainPermanent, so the copy outlives it, and adds it to the list; the rest just use it.
+   Each entry counts the Eterms using it, and the last one to let go kills the pixmap.  When a
+   source pixmap goes away (Esetroot and friends kill the old one when the background changes),
+   whoever next updates the list kills the shaded copies made from it, which also takes care of
+   the ones still counting Eterms that died without letting go. */
+#   define SHADE_CACHE_SRC      0
+#   define SHADE_CACHE_W        1
+#   define SHADE_CACHE_H        2
+#   define SHADE_CACHE_RM       3
+#   define SHADE_CACHE_GM       4
+#   define SHADE_CACHE_BM       5
+#   define SHADE_CACHE_PIXMAP   6       /* everything before this is the key */
+#   define SHADE_CACHE_USERS    7
+#   define SHADE_CACHE_FIELDS   8
+#   define SHADE_CACHE_MAX      16
+
+/* Fetch the list.  Returns the number of entries; *list is to be XFree()'d if it isn't NULL. */
+static unsigned long
+shade_cache_read(long **list)
+{
+    Atom type;
+    int format;
+    unsigned long length, after;
+    unsigned char *data = NULL;
+
+    *list = NULL;
+    if (XGetWindowProperty(Xdisplay, Xroot, props[PROP_SHADE_CACHE], 0L, SHADE_CACHE_MAX * SHADE_CACHE_FIELDS, False, XA_CARDINAL,
+                           &type, &format, &length, &after, &data) != Success) {
+        return 0;
+    }
+    if (type != XA_CARDINAL || format != 32) {
+        if (data) {
+            XFree(data);
+        }
+        return 0;
+    }
+    *list = (long *) data;
+    return (length / SHADE_CACHE_FIELDS);
+}
+
+/* Whether p is still a pixmap on the server. */
+static unsigned char
+shade_cache_alive(Pixmap p)
+{
+    Window root;
+    int x, y;
+    unsigned int w, h, b, d;
+    Status ok;
+
+    x_trap_errors();
+    ok = XGetGeometry(Xdisplay, p, &root, &x, &y, &w, &h, &b, &d);
+    return (!x_untrap_errors() && ok);
+}
+
+/* Grab the server and fetch the list minus the dead entries, into *list (room for one more, to
+   be handed to shade_cache_unlock()).  Returns the number of entries. */
+static unsigned long
+shade_cache_lock(long **list)
+{
+    long *data, *ent;
+    unsigned long n, i, kept;
+
+    XGrabServer(Xdisplay);
+    n = shade_cache_read(&data);
+    *list = (long *) MALLOC((n + 1) * SHADE_CACHE_FIELDS * sizeof(long));
+    for (i = kept = 0, ent = data; i < n; i++, ent += SHADE_CACHE_FIELDS) {
+        if (!shade_cache_alive((Pixmap) ent[SHADE_CACHE_PIXMAP])) {
+            continue;
+        } else if (!shade_cache_alive((Pixmap) ent[SHADE_CACHE_SRC])) {
+            D_PIXMAP(("Source of shared pixmap 0x%08x is gone; killing it.\n", (Pixmap) ent[SHADE_CACHE_PIXMAP]));
+            XKillClient(Xdisplay, (XID) ent[SHADE_CACHE_PIXMAP]);
+            continue;
+        }
+        memcpy(*list + kept * SHADE_CACHE_FIELDS, ent, SHADE_CACHE_FIELDS * sizeof(long));
+        kept++;
+    }
+    if (data) {
+        XFree(data);
+    }
+    return kept;
+}
+
+/* Store the n entries of list from shade_cache_lock() and let the server go. */
+static void
+shade_cache_unlock(long *list, unsigned long n)
+{
+    XChangeProperty(Xdisplay, Xroot, props[PROP_SHADE_CACHE], XA_CARDINAL, 32, PropModeReplace, (unsigned char *) list, (int) n);
+    XUngrabServer(Xdisplay);
+    XFlush(Xdisplay);
+    FREE(list);
+}
+
+/* A w x h pixmap that stays on the server after its creator is gone, until someone kills it. */
+static Pixmap
+shade_cache_create(unsigned int w, unsigned int h)
+{
+    Display *d;
+    Pixmap p;
+
+    if (!(d = XOpenDisplay(DisplayString(Xdisplay)))) {
+        D_PIXMAP(("Unable to open a second connection to %s.\n", DisplayString(Xdisplay)));
+        return None;
+    }
+    p = XCreatePixmap(d, RootWindow(d, Xscreen), w, h, Xdepth);
+    XSetCloseDownMode(d, RetainPermanent);
+    XCloseDisplay(d);
+    return p;
+}
+
+/* The first w x h of src, shaded for iml, from the shared list if it's there and added to it if
+   not.  Returns None if it couldn't be shared; the caller then makes a private copy.  Anything
+   returned must go back through shade_cache_release() when it's no longer used. */
+static Pixmap
+shade_cache_get(Pixmap src, unsigned int w, unsigned int h, imlib_t *iml, GC gc)
+{
+    long key[SHADE_CACHE_FIELDS], *list, *ent;
+    unsigned long n, i;
+    unsigned short rm, gm, bm;
+    Pixmap p = None, found = None;
+
+    colormod_trans_mods(iml, &rm, &gm, &bm);
+    key[SHADE_CACHE_SRC] = (long) src;
+    key[SHADE_CACHE_W] = (long) w;
+    key[SHADE_CACHE_H] = (long) h;
+    key[SHADE_CACHE_RM] = (long) rm;
+    key[SHADE_CACHE_GM] = (long) gm;
+    key[SHADE_CACHE_BM] = (long) bm;
+
+    n = shade_cache_read(&list);
+    for (i = 0, ent = list; i < n; i++, ent += SHADE_CACHE_FIELDS) {
+        if (!memcmp(ent, key, SHADE_CACHE_PIXMAP * sizeof(long))) {
+            found = (Pixmap) ent[SHADE_CACHE_PIXMAP];
+            break;
+        }
+    }
+    if (list) {
+        XFree(list);
+    }
+    if (found == None || !shade_cache_alive(found)) {
+        /* Not there; shade our own without holding anyone up. */
+        if ((p = shade_cache_create(w, h)) == None) {
+            return None;
+        }
+        XCopyArea(Xdisplay, src, p, gc, 0, 0, w, h, 0, 0);
+        colormod_trans(p, iml, gc, w, h);
+    }
+
+    /* Then count ourselves in, or add ours, with nobody else changing the list meanwhile. */
+    found = None;
+    n = shade_cache_lock(&list);
+    for (i = 0, ent = list; i < n; i++, ent += SHADE_CACHE_FIELDS) {
+        if (!memcmp(ent, key, SHADE_CACHE_PIXMAP * sizeof(long))) {
+            found = (Pixmap) ent[SHADE_CACHE_PIXMAP];
+            ent[SHADE_CACHE_USERS]++;
+            D_PIXMAP(("Using shared shaded desktop pixmap 0x%08x (%ld users).\n", found, ent[SHADE_CACHE_USERS]));
+            break;
+        }
+    }
+    if (found == None && p != None && n < SHADE_CACHE_MAX) {
+        key[SHADE_CACHE_PIXMAP] = (long) p;
+        key[SHADE_CACHE_USERS] = 1;
+        memcpy(list + n * SHADE_CACHE_FIELDS, key, SHADE_CACHE_FIELDS * sizeof(long));
+        n++;
+        found = p;
+        D_PIXMAP(("Shared shaded desktop pixmap 0x%08x (%lu in list).\n", p, n));
+    } else if (p != None && p != found) {
+        /* Another Eterm got here first, or there's no room. */
+        XKillClient(Xdisplay, (XID) p);
+    }
+    shade_cache_unlock(list, n);
+    return found;
+}
+
+/* Stop using p from shade_cache_get(), killing it if nobody else is. */
+static void
+shade_cache_release(Pixmap p)
+{
+    long *list, *ent;
+    unsigned long n, i;
+
+    n = shade_cache_lock(&list);
+    for (i = 0, ent = list; i < n; i++, ent += SHADE_CACHE_FIELDS) {
+        if ((Pixmap) ent[SHADE_CACHE_PIXMAP] == p) {
+            if (--ent[SHADE_CACHE_USERS] <= 0) {
+                D_PIXMAP(("Last user of shared pixmap 0x%08x; killing it.\n", p));
+                XKillClient(Xdisplay, (XID) p);
+                memmove(ent, ent + SHADE_CACHE_FIELDS, (n - i - 1) * SHADE_CACHE_FIELDS * sizeof(long));
+                n--;
+            }
+            break;
+        }
+    }
+    shade_cache_unlock(list, n);
+}
+
 unsigned char
 update_desktop_info(int *w, int *h)
 {
@@ -2056,17 +2621,20 @@ get_desktop_pixmap(void)
                     gc = LIBAST_X_CREATE_GC(GCForeground | GCBackground, &gcvalue);
                     XGetGeometry(Xdisplay, p, &w, &px, &py, &pw, &ph, &pb, &pd);
                     D_PIXMAP(("XGetGeometry() returned w = 0x%08x, pw == %u, ph == %u\n", w, pw, ph));
-                    if (pw < (unsigned int) scr->width || ph < (unsigned int) scr->height) {
+                    if (pw >= (unsigned int) scr->width && ph >= (unsigned int) scr->height) {
+                        pw = scr->width;
+                        ph = scr->height;
+                    }
+                    if ((desktop_pixmap = shade_cache_get(p, pw, ph, images[image_bg].current->iml, gc)) != None) {
+                        desktop_pixmap_is_mine = 0;
+                        desktop_pixmap_is_shared = 1;
+                    } else {
                         desktop_pixmap = LIBAST_X_CREATE_PIXMAP(pw, ph);
                         XCopyArea(Xdisplay, p, desktop_pixmap, gc, 0, 0, pw, ph, 0, 0);
                         colormod_trans(desktop_pixmap, images[image_bg].current->iml, gc, pw, ph);
-                    } else {
-                        desktop_pixmap = LIBAST_X_CREATE_PIXMAP(scr->width, scr->height);
-                        XCopyArea(Xdisplay, p, desktop_pixmap, gc, 0, 0, scr->width, scr->height, 0, 0);
-                        colormod_trans(desktop_pixmap, images[image_bg].current->iml, gc, scr->width, scr->height);
+                        desktop_pixmap_is_mine = 1;
                     }
                     LIBAST_X_FREE_GC(gc);
-                    desktop_pixmap_is_mine = 1;
                     D_PIXMAP(("Returning 0x%08x\n", (unsigned int) desktop_pixmap));
                     return (desktop_pixmap);
                 } else {
@@ -2106,13 +2674,71 @@ get_desktop_pixmap(void)
     return (desktop_pixmap = None);
 }
 
+/* Screen-sized copies of desktop_pixmap shaded for the images that tint it themselves (all but
+   the background, whose shading desktop_pixmap already has), so that moving the window only
+   means tiling from them again.  They go when desktop_pixmap does. */
+#   define SHADED_DESKTOP_MAX   4
+static struct {
+    Pixmap pmap;
+    unsigned short rm, gm, bm;
+    unsigned char mine;
+} shaded_desktops[SHADED_DESKTOP_MAX];
+static unsigned char nshaded_desktops = 0;
+
+/* desktop_pixmap, which is w x h, shaded for iml.  None if there's no room for another. */
+Pixmap
+get_shaded_desktop_pixmap(imlib_t *iml, unsigned int w, unsigned int h)
+{
+    unsigned short rm, gm, bm;
+    unsigned char i;
+    Pixmap p;
+    GC gc;
+
+    colormod_trans_mods(iml, &rm, &gm, &bm);
+    for (i = 0; i < nshaded_desktops; i++) {
+        if (shaded_desktops[i].rm == rm && shaded_desktops[i].gm == gm && shaded_desktops[i].bm == bm) {
+            return shaded_desktops[i].pmap;
+        }
+    }
+    if (nshaded_desktops == SHADED_DESKTOP_MAX || desktop_pixmap == None) {
+        return None;
+    }
+
+    gc = LIBAST_X_CREATE_GC(0, NULL);
+    shaded_desktops[i].mine = 0;
+    if ((p = shade_cache_get(desktop_pixmap, w, h, iml, gc)) == None) {
+        p = LIBAST_X_CREATE_PIXMAP(w, h);
+        XCopyArea(Xdisplay, desktop_pixmap, p, gc, 0, 0, w, h, 0, 0);
+        colormod_trans(p, iml, gc, w, h);
+        shaded_desktops[i].mine = 1;
+    }
+    LIBAST_X_FREE_GC(gc);
+    shaded_desktops[i].pmap = p;
+    shaded_desktops[i].rm = rm;
+    shaded_desktops[i].gm = gm;
+    shaded_desktops[i].bm = bm;
+    nshaded_desktops++;
+    D_PIXMAP(("Shaded %ux%u copy of the desktop for rm %hu, gm %hu, bm %hu is 0x%08x.\n", w, h, rm, gm, bm, p));
+    return p;
+}
+
 void
 free_desktop_pixmap(void)
 {
+    for (; nshaded_desktops; nshaded_desktops--) {
+        if (shaded_desktops[nshaded_desktops - 1].mine) {
+            LIBAST_X_FREE_PIXMAP(shaded_desktops[nshaded_desktops - 1].pmap);
+        } else {
+            shade_cache_release(shaded_desktops[nshaded_desktops - 1].pmap);
+        }
+    }
     if (desktop_pixmap_is_mine && desktop_pixmap != None) {
         LIBAST_X_FREE_PIXMAP(desktop_pixmap);
         desktop_pixmap_is_mine = 0;
+    } else if (desktop_pixmap_is_shared && desktop_pixmap != None) {
+        shade_cache_release(desktop_pixmap);
     }
+    desktop_pixmap_is_shared = 0;
     desktop_pixmap = None;
 }
 
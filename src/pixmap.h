@@ -253,6 +253,7 @@ extern void colormod_trans(Pixmap, imlib_t *, GC, unsigned short, unsigned short
 extern unsigned char update_desktop_info(int *, int *);
 extern Window get_desktop_window(void);
 extern Pixmap get_desktop_pixmap(void);
+extern Pixmap get_shaded_desktop_pixmap(imlib_t *, unsigned int, unsigned int);
 # endif
 extern void shaped_window_apply_mask(Drawable, Pixmap);
 extern void set_icon_pixmap(char *, XWMHints *);
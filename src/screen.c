@@ -37,6 +37,7 @@ static const char cvs_ident[] = "$Id$";
 #include "pixmap.h"
 #include "profile.h"
 #include "term.h"
+#include "timer.h"
 
 #ifdef ESCREEN
 #  include "screamcfg.h"
@@ -55,15 +56,95 @@ static rend_t **buf_rend = NULL;
 /* Tab stop locations */
 static char *tabs = NULL;
 
+/* Row arena.  Every row of screen, swap, and drawn_text/drawn_rend is a single
+   cell cut from a large slab:  a row_runs_t header, TermWin.ncol rend_t's, and
+   then the TermWin.ncol + 1 text_t's.  Released rows go on a free list (linked
+   through the cell itself) and are handed out again before any new slab is
+   made, and a change in the number of columns rebuilds the whole arena at once. */
+#define ROW_SLAB_ROWS       256
+#define ROW_CELL_REND(c)    ((rend_t *) ((row_runs_t *) (c) + 1))
+#define ROW_CELL_TEXT(c)    ((text_t *) (ROW_CELL_REND(c) + row_arena.ncol))
+
+/* Rendition runs.  The header of each row describes its rend_t's as up to
+   ROW_MAX_RUNS (start column, rend) runs; run i covers the columns from
+   start[i] up to start[i + 1] (or the end of the row).  The rend_t array is
+   still what everything reads, but scr_add_lines() uses the runs to skip
+   redundant stores, and scr_refresh() skips comparing the rendition of rows
+   whose runs match what was drawn.  Code that writes into a row's rend_t's
+   behind the back of row_runs_span()/row_runs_fill() must ROW_RUNS_FORGET() it;
+   scr_refresh() recomputes forgotten runs when it next looks at the row. */
+#define ROW_MAX_RUNS        6
+#define ROW_RUNS_UNKNOWN    0           /* nruns when the runs must be recounted  */
+#define ROW_RUNS_MANY       0xffff      /* nruns when there are too many to keep  */
+#define ROW_RUNS(r)         (((row_runs_t *) (r)) - 1)
+#define ROW_RUNS_KNOWN(r)   (ROW_RUNS(r)->nruns != ROW_RUNS_UNKNOWN && ROW_RUNS(r)->nruns != ROW_RUNS_MANY)
+#define ROW_RUNS_FORGET(r)  (ROW_RUNS(r)->nruns = ROW_RUNS_UNKNOWN)
+
+typedef struct {
+    unsigned short nruns;
+    unsigned short start[ROW_MAX_RUNS];
+    rend_t rend[ROW_MAX_RUNS];
+} row_runs_t;
+
+typedef struct row_slab_struct {
+    struct row_slab_struct *next;
+} row_slab_t;
+
+typedef struct {
+    row_slab_t *slabs;          /* every slab allocated, newest first        */
+    void *free_rows;            /* singly-linked list of released cells      */
+    char *next_cell, *end_cell; /* unused tail of the newest slab            */
+    int ncol;                   /* columns per row                           */
+    size_t cell_size;           /* bytes per row, rounded for alignment      */
+} row_arena_t;
+
+static row_arena_t row_arena = { NULL, NULL, NULL, NULL, 0, 0 };
+
+/* Cold scrollback.  Rows more than TermWin.coldLines above the bottom of the
+   scrollback are packed:  the text minus its trailing blanks, and the rendition
+   as (rend, count) runs, since most rows only have one or two.  Packed rows are
+   carved out of large cold blocks, and a block is freed once the last row in it
+   is gone.  A packed row has NULL screen.text/screen.rend pointers; its packed
+   copy is in cold_rows[], which is indexed by ring slot just like screen.text.
+   scr_thaw_rows() unpacks rows for whoever needs to look at them, and
+   cold_sweep() packs them up again once they are out of sight. */
+#define COLD_BLOCK_SIZE     32768
+#define COLD_BOUNDARY()     (TermWin.saveLines - TermWin.coldLines)
+#define COLD_ROW_RUNS(c)    ((cold_run_t *) ((cold_row_t *) (c) + 1))
+#define COLD_ROW_TEXT(c)    ((text_t *) (COLD_ROW_RUNS(c) + (c)->nruns))
+
+typedef struct {
+    unsigned int live;          /* rows still packed into this block         */
+    size_t used, size;          /* bytes handed out so far / bytes in total  */
+} cold_block_t;
+
+typedef struct {
+    rend_t rend;
+    unsigned short count;
+} cold_run_t;
+
+typedef struct {
+    cold_block_t *block;        /* the block this row was packed into        */
+    unsigned short ncol;        /* number of columns when it was packed      */
+    unsigned short len;         /* text bytes kept                           */
+    unsigned short nruns;       /* rendition runs stored before the text     */
+    text_t eol;                 /* line length/WRAP_CHAR (i.e., text[ncol])  */
+} cold_row_t;
+
+static cold_row_t **cold_rows = NULL;
+static cold_block_t *cold_block = NULL; /* block currently being filled */
+/* Ring slots of rows in the cold zone that scr_thaw_rows() has unpacked. */
+static int *cold_thawed = NULL, cold_nthawed = 0, cold_thawed_size = 0;
+
 #ifndef ESCREEN
 static
 #endif
 screen_t screen = {
-    NULL, NULL, 0, 0, 0, 0, 0, Screen_DefaultFlags
+    NULL, NULL, 0, 0, 0, 0, 0, Screen_DefaultFlags, 0, 0
 };
 
 static screen_t swap = {
-    NULL, NULL, 0, 0, 0, 0, 0, Screen_DefaultFlags
+    NULL, NULL, 0, 0, 0, 0, 0, Screen_DefaultFlags, 0, 0
 };
 
 static save_t save = {
@@ -74,7 +155,10 @@ static selection_t selection = {
     NULL, 0, SELECTION_CLEAR, PRIMARY, 0,
     {0, 0},
     {0, 0},
-    {0, 0}
+    {0, 0},
+    {0, 0},
+    {0, 0},
+    0
 };
 
 static char charsets[4] = {
@@ -87,6 +171,79 @@ static short rvideo = 0;
 int prev_nrow = -1, prev_ncol = -1;
 unsigned char refresh_all = 0;
 
+/* Net scroll of the visible screen since the last refresh:  rows scroll_top through
+   scroll_bot have moved up by scroll_count rows (down if it's negative).  scr_refresh() uses
+   this to move the pixels that are already on the window instead of redrawing them.
+   Scrolling some other region, or scrolling while the view is back in the scrollback, sets
+   scroll_mixed and the next refresh just redraws. */
+static int scroll_top, scroll_bot, scroll_count = 0;
+static unsigned char scroll_mixed = 0;
+
+/* Blits straight onto the window whose GraphicsExpose/NoExpose events haven't come back yet.
+   Parts of the window that were covered when they were copied arrive as GraphicsExpose and
+   get redrawn by scr_expose(), but only at the place they were copied to, so there's no
+   blitting again until they're all in. */
+unsigned int scroll_blits_pending = 0;
+
+/* Copying pixels from one row to another only works if nothing behind the text depends on
+   where on the window it is. */
+#define SCROLL_BLIT_SAFE()  (((images[image_bg].mode & MODE_MASK) == MODE_SOLID) && !fshadow.do_shadow)
+
+/* Rows of the screen that may not match what's been drawn, one bit per row, along with the
+   leftmost column in each that may have changed.  scr_refresh() only looks at these rows.
+   Changes that would touch most of the screen anyway just set dirty_all, and so does
+   anything that scrolls the view, since the bits are by screen row and not window row. */
+static unsigned long *dirty_rows = NULL;
+static int *dirty_col = NULL, dirty_nrow = 0, dirty_view = -1;
+static unsigned char dirty_all = 1;
+
+#define DIRTY_BITS          (sizeof(unsigned long) * 8)
+#define ROW_IS_DIRTY(r)     (dirty_rows[(r) / DIRTY_BITS] & (1UL << ((r) % DIRTY_BITS)))
+#define DIRTY_ROW(r, c)     do {if ((unsigned) (r) < (unsigned) dirty_nrow) {dirty_rows[(r) / DIRTY_BITS] |= (1UL << ((r) % DIRTY_BITS)); \
+                                                                            UPPER_BOUND(dirty_col[(r)], (c));}} while (0)
+/* Same, by buffer row */
+#define scr_dirty(row, col)  DIRTY_ROW((row) - TermWin.saveLines, (col))
+
+/* Screen rows <r1> through <r2> are about to change; if a lazy selection's text is still
+   sitting in them, save it first. */
+#define SELECTION_SAVE(r1, r2)  do {if (selection.lazy && current_screen == selection.screen && (r2) >= selection.text_beg.row \
+                                        && (r1) <= selection.text_end.row) selection_save();} while (0)
+static void selection_save(void);
+static void selection_send_detach(void);
+
+/* What the server currently has for TermWin.gc, as far as scr_refresh() is concerned.  Runs
+   drawn in the same colors and font as the run before them then cost no GC requests at all. */
+static XGCValues gc_state;
+
+#define scr_gc_foreground(p)  do {XGCValues gcv; gcv.foreground = (p); scr_gc_change(GCForeground, &gcv);} while (0)
+#define scr_gc_font(f)        do {XGCValues gcv; gcv.font = (f); scr_gc_change(GCFont, &gcv);} while (0)
+
+/* Text and decoration lines drawn by scr_refresh() but not sent yet.  Everything queued here
+   shares the current state of TermWin.gc, so scr_gc_change() sends it before changing that;
+   text on one baseline goes out as a single PolyText8, the lines as a single PolySegment. */
+#define DRAW_QUEUE_LEN  64
+#define QUEUE_FONT()    ((gc_state.font == TermWin.font->fid) ? (TermWin.font) : (TermWin.boldFont))
+
+/* The parts of buffer_pixmap that scr_refresh() has drawn on, which get copied to the window
+   once it's done (corners inclusive).  Boxes are merged as they come in whenever that wastes
+   little, so the runs of one row usually end up as a single box; when the list is full, a
+   new box goes into whichever one it grows the least. */
+#define DAMAGE_MAX  16
+static struct {
+    int x1, y1, x2, y2;
+} damage[DAMAGE_MAX];
+static int ndamage = 0;
+
+#define DAMAGE_AREA(x1, y1, x2, y2)  ((long) ((x2) - (x1) + 1) * ((y2) - (y1) + 1))
+static struct {
+    Drawable d;
+    int x, y, end;              /* where the queued text starts, its baseline, and where it ends */
+    int nitems, nsegs, len;
+    XTextItem items[DRAW_QUEUE_LEN];
+    XSegment segs[DRAW_QUEUE_LEN];
+    char text[MAX_COLS];
+} draw_queue;
+
 #ifdef MULTI_CHARSET
 static short multi_byte = 0;
 static short lost_multi = 0;
@@ -114,30 +271,553 @@ blank_line(text_t *et, rend_t *er, int width, rend_t efs)
         *r++ = fs;
 }
 
+/* Set up an empty row arena for rows of <ncol> columns. */
+static void
+row_arena_init(int ncol)
+{
+    row_arena.slabs = NULL;
+    row_arena.free_rows = NULL;
+    row_arena.next_cell = row_arena.end_cell = NULL;
+    row_arena.ncol = ncol;
+    row_arena.cell_size = sizeof(row_runs_t) + sizeof(rend_t) * ncol + sizeof(text_t) * (ncol + 1);
+    row_arena.cell_size = (row_arena.cell_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    D_SCREEN(("Row arena:  %d columns, %lu bytes per row, %d rows per slab\n", ncol, (unsigned long) row_arena.cell_size,
+              ROW_SLAB_ROWS));
+}
+
+/* Free every slab in the arena at once. */
+static void
+row_arena_release(void)
+{
+    row_slab_t *slab;
+
+    for (; row_arena.slabs; row_arena.slabs = slab) {
+        slab = row_arena.slabs->next;
+        FREE(row_arena.slabs);
+    }
+    row_arena.free_rows = NULL;
+    row_arena.next_cell = row_arena.end_cell = NULL;
+}
+
+/* Get a row from the arena.  The contents are undefined. */
+static void
+row_alloc(text_t **tp, rend_t **rp)
+{
+    void *cell;
+
+    if (row_arena.free_rows) {
+        cell = row_arena.free_rows;
+        row_arena.free_rows = *((void **) cell);
+    } else {
+        if (row_arena.next_cell == row_arena.end_cell) {
+            row_slab_t *slab;
+
+            /* The header is pointer-sized, so the cells stay pointer-aligned. */
+            slab = (row_slab_t *) MALLOC(sizeof(row_slab_t) + ROW_SLAB_ROWS * row_arena.cell_size);
+            slab->next = row_arena.slabs;
+            row_arena.slabs = slab;
+            row_arena.next_cell = (char *) (slab + 1);
+            row_arena.end_cell = row_arena.next_cell + ROW_SLAB_ROWS * row_arena.cell_size;
+        }
+        cell = row_arena.next_cell;
+        row_arena.next_cell += row_arena.cell_size;
+    }
+    *rp = ROW_CELL_REND(cell);
+    *tp = ROW_CELL_TEXT(cell);
+}
+
+/* Return a row to the arena. */
+static void
+row_free(rend_t *r)
+{
+    void *cell = (void *) ROW_RUNS(r);
+
+    *((void **) cell) = row_arena.free_rows;
+    row_arena.free_rows = cell;
+}
+
+/* Count the runs in the row whose rend_t's are <r>. */
+static void
+row_runs_scan(rend_t *r)
+{
+    register row_runs_t *runs = ROW_RUNS(r);
+    register int col, n;
+
+    runs->start[0] = 0;
+    runs->rend[0] = r[0];
+    for (n = 1, col = 1; col < row_arena.ncol; col++) {
+        if (r[col] != r[col - 1]) {
+            if (n == ROW_MAX_RUNS) {
+                runs->nruns = ROW_RUNS_MANY;
+                return;
+            }
+            runs->start[n] = col;
+            runs->rend[n++] = r[col];
+        }
+    }
+    runs->nruns = n;
+}
+
+/* The whole row is now a single run of <rend>. */
+static inline void
+row_runs_fill(rend_t *r, rend_t rend)
+{
+    ROW_RUNS(r)->nruns = 1;
+    ROW_RUNS(r)->start[0] = 0;
+    ROW_RUNS(r)->rend[0] = rend;
+}
+
+/* Store <rend> in the <n> columns starting at <col> of the row whose rend_t's
+   are <r>, and update its runs.  Extending the previous run is the common
+   case. */
+static void
+row_runs_span(rend_t *r, int col, int n, rend_t rend)
+{
+    register row_runs_t *runs = ROW_RUNS(r);
+    register int i, j, k;
+    int end = col + n, end_j;
+    unsigned short start[ROW_MAX_RUNS + 2];
+    rend_t rends[ROW_MAX_RUNS + 2];
+
+    for (k = col; k < end; k++)
+        r[k] = rend;
+    if (!ROW_RUNS_KNOWN(r)) {
+        runs->nruns = ROW_RUNS_UNKNOWN;
+        return;
+    }
+    for (i = runs->nruns - 1; runs->start[i] > col; i--);
+    for (j = i; j + 1 < runs->nruns && runs->start[j + 1] < end; j++);
+    if (i == j && runs->rend[i] == rend) {
+        return;
+    }
+    end_j = ((j + 1 < runs->nruns) ? (runs->start[j + 1]) : (row_arena.ncol));
+    if (i == j && i > 0 && col == runs->start[i] && runs->rend[i - 1] == rend && end < end_j) {
+        runs->start[i] = end;
+        return;
+    }
+
+    /* Cut <col> through <end> out of runs i through j, then merge equal neighbors. */
+    for (n = 0; n < i; n++) {
+        start[n] = runs->start[n];
+        rends[n] = runs->rend[n];
+    }
+    if (col > runs->start[i]) {
+        start[n] = runs->start[i];
+        rends[n++] = runs->rend[i];
+    }
+    start[n] = col;
+    rends[n++] = rend;
+    if (end < end_j) {
+        start[n] = end;
+        rends[n++] = runs->rend[j];
+    }
+    for (j++; j < runs->nruns; j++) {
+        start[n] = runs->start[j];
+        rends[n++] = runs->rend[j];
+    }
+    for (k = 0, runs->nruns = 0; k < n; k++) {
+        if (runs->nruns && runs->rend[runs->nruns - 1] == rends[k]) {
+            continue;
+        }
+        if (runs->nruns == ROW_MAX_RUNS) {
+            runs->nruns = ROW_RUNS_MANY;
+            return;
+        }
+        runs->start[runs->nruns] = start[k];
+        runs->rend[runs->nruns++] = rends[k];
+    }
+}
+#define row_runs_set(r, col, rend)  row_runs_span((r), (col), 1, (rend))
+
+/* Are the rend_t's of these two rows known to be identical? */
+static inline int
+row_runs_equal(rend_t *r1, rend_t *r2)
+{
+    register row_runs_t *a = ROW_RUNS(r1), *b = ROW_RUNS(r2);
+    register int i;
+
+    if (!ROW_RUNS_KNOWN(r1) || a->nruns != b->nruns) {
+        return 0;
+    }
+    for (i = 0; i < a->nruns; i++) {
+        if (a->start[i] != b->start[i] || a->rend[i] != b->rend[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Move every row over to a new arena with <ncol> columns, keeping as much of
+   each row as fits and blanking the rest.  The old slabs are freed in one go. */
+static void
+row_arena_resize(int ncol)
+{
+    row_arena_t old = row_arena, new_arena;
+    register int i, j, n;
+    int prev_ncol = old.ncol;
+    text_t *t;
+    rend_t *r;
+    text_t **text_rows[3];
+    rend_t **rend_rows[3];
+    int num_rows[3];
+
+    row_arena_init(ncol);
+
+    text_rows[0] = screen.text;
+    rend_rows[0] = screen.rend;
+    num_rows[0] = screen.slots;
+    text_rows[1] = swap.text;
+    rend_rows[1] = swap.rend;
+    num_rows[1] = TERM_WINDOW_GET_REPORTED_ROWS();
+    text_rows[2] = drawn_text;
+    rend_rows[2] = drawn_rend;
+    num_rows[2] = TERM_WINDOW_GET_REPORTED_ROWS();
+
+    n = MIN(ncol, prev_ncol);
+    for (j = 0; j < 3; j++) {
+        for (i = 0; i < num_rows[j]; i++) {
+            if (!rend_rows[j][i]) {
+                continue;
+            }
+            row_alloc(&t, &r);
+            memcpy(t, text_rows[j][i], n * sizeof(text_t));
+            memcpy(r, rend_rows[j][i], n * sizeof(rend_t));
+            t[ncol] = MIN(text_rows[j][i][prev_ncol], ncol);
+            if (ncol > prev_ncol) {
+                blank_line(&(t[prev_ncol]), &(r[prev_ncol]), ncol - prev_ncol, DEFAULT_RSTYLE);
+            }
+            ROW_RUNS_FORGET(r);
+            text_rows[j][i] = t;
+            rend_rows[j][i] = r;
+        }
+    }
+
+    /* Any other row pointers (i.e., buf_text/buf_rend) are just scratch space. */
+    new_arena = row_arena;
+    row_arena = old;
+    row_arena_release();
+    row_arena = new_arena;
+}
+
+/* Drop the packed copy of the row in ring slot <slot>, if it has one. */
+static void
+cold_free(int slot)
+{
+    cold_block_t *block;
+
+    if (!cold_rows || !cold_rows[slot]) {
+        return;
+    }
+    block = cold_rows[slot]->block;
+    cold_rows[slot] = NULL;
+    if (--block->live == 0) {
+        if (block == cold_block) {
+            block->used = sizeof(cold_block_t);
+        } else {
+            FREE(block);
+        }
+    }
+}
+
+/* Pack buffer row <row> into the cold block and give its row back to the
+   arena.  Selection highlighting is dropped; selected rows are never packed. */
+static void
+cold_pack(int row)
+{
+    register int col, len, nruns;
+    int slot = SCREEN_SLOT(row), ncol = row_arena.ncol;
+    text_t *t = screen.text[slot];
+    rend_t *r = screen.rend[slot], rend;
+    cold_row_t *c;
+    cold_run_t *run;
+    size_t size;
+
+    if (!t) {
+        return;
+    }
+    for (len = ncol; len > 0 && t[len - 1] == ' '; len--);
+    for (nruns = 1, col = 1; col < ncol; col++) {
+        if ((r[col] & ~RS_Select) != (r[col - 1] & ~RS_Select)) {
+            nruns++;
+        }
+    }
+    size = sizeof(cold_row_t) + nruns * sizeof(cold_run_t) + len;
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    if (!cold_block || cold_block->used + size > cold_block->size) {
+        if (cold_block && !cold_block->live) {
+            FREE(cold_block);
+        }
+        cold_block = (cold_block_t *) MALLOC(MAX(COLD_BLOCK_SIZE, sizeof(cold_block_t) + size));
+        cold_block->live = 0;
+        cold_block->used = sizeof(cold_block_t);
+        cold_block->size = MAX(COLD_BLOCK_SIZE, sizeof(cold_block_t) + size);
+    }
+    c = (cold_row_t *) ((char *) cold_block + cold_block->used);
+    cold_block->used += size;
+    cold_block->live++;
+
+    c->block = cold_block;
+    c->ncol = ncol;
+    c->len = len;
+    c->nruns = nruns;
+    c->eol = t[ncol];
+    run = COLD_ROW_RUNS(c);
+    run->rend = r[0] & ~RS_Select;
+    run->count = 1;
+    for (col = 1; col < ncol; col++) {
+        rend = r[col] & ~RS_Select;
+        if (rend == run->rend) {
+            run->count++;
+        } else {
+            (++run)->rend = rend;
+            run->count = 1;
+        }
+    }
+    memcpy(COLD_ROW_TEXT(c), t, len);
+
+    row_free(r);
+    screen.text[slot] = NULL;
+    screen.rend[slot] = NULL;
+    cold_rows[slot] = c;
+}
+
+/* Unpack the row in ring slot <slot>, which may have been packed at another width. */
+static void
+cold_unpack(int slot)
+{
+    register int col, end;
+    int ncol = row_arena.ncol;
+    cold_row_t *c = cold_rows[slot];
+    cold_run_t *run = COLD_ROW_RUNS(c);
+    text_t *t;
+    rend_t *r;
+
+    row_alloc(&t, &r);
+    end = MIN(c->len, ncol);
+    memcpy(t, COLD_ROW_TEXT(c), end);
+    memset(t + end, ' ', ncol - end);
+    t[ncol] = ((c->ncol == ncol) ? (c->eol) : MIN(c->eol, ncol));
+
+    for (col = 0; col < ncol && col < c->ncol; run++) {
+        for (end = MIN(col + run->count, ncol); col < end; col++) {
+            r[col] = run->rend;
+        }
+    }
+    for (; col < ncol; col++) {
+        r[col] = DEFAULT_RSTYLE;
+    }
+    ROW_RUNS_FORGET(r);
+    screen.text[slot] = t;
+    screen.rend[slot] = r;
+    cold_free(slot);
+}
+
+/* Unpacked rows that are on the screen or part of the selection stay that way. */
+static int
+cold_pinned(int row)
+{
+    int top = TermWin.saveLines - TermWin.view_start;
+
+    if (row >= top && row < top + TERM_WINDOW_GET_REPORTED_ROWS()) {
+        return 1;
+    }
+    if (selection.op && (row >= MIN(selection.beg.row, selection.mark.row) + TermWin.saveLines)
+        && (row <= MAX(selection.end.row, selection.mark.row) + TermWin.saveLines)) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Remember that the row in ring slot <slot> should be packed once it isn't pinned. */
+static void
+cold_remember(int slot)
+{
+    if (cold_nthawed == cold_thawed_size) {
+        cold_thawed_size = (cold_thawed_size ? (cold_thawed_size * 2) : 64);
+        cold_thawed = (int *) REALLOC(cold_thawed, cold_thawed_size * sizeof(int));
+    }
+    cold_thawed[cold_nthawed++] = slot;
+}
+
+/* The ring just moved up <count> rows:  pack the rows that crossed the cold boundary. */
+static void
+cold_advance(int count)
+{
+    register int row, end;
+
+    if (TermWin.coldLines <= 0 || (end = COLD_BOUNDARY()) <= 0) {
+        return;
+    }
+    for (row = MAX(end - count, TermWin.saveLines - TermWin.nscrolled); row < end; row++) {
+        if (!SCREEN_TEXT(row)) {
+            continue;
+        }
+        if (cold_pinned(row)) {
+            cold_remember(SCREEN_SLOT(row));
+        } else {
+            cold_pack(row);
+        }
+    }
+}
+
+/* Pack up whatever scr_thaw_rows() unpacked and nobody is looking at anymore. */
+static void
+cold_sweep(void)
+{
+    register int i, n, row;
+
+    for (i = n = 0; i < cold_nthawed; i++) {
+        if (cold_thawed[i] >= screen.slots || !screen.text[cold_thawed[i]]) {
+            continue;
+        }
+        row = (cold_thawed[i] - screen.head + screen.slots) % screen.slots;
+        if (row < TermWin.saveLines - TermWin.nscrolled || row >= COLD_BOUNDARY()) {
+            continue;
+        }
+        if (cold_pinned(row)) {
+            cold_thawed[n++] = cold_thawed[i];
+        } else {
+            cold_pack(row);
+        }
+    }
+    cold_nthawed = n;
+}
+
+/* Unpack buffer row <row> for a quick look.  If this returns 1, the caller
+   has to cold_pack() it again when it is done. */
+static int
+cold_peek(int row)
+{
+    int slot = SCREEN_SLOT(row);
+
+    if (cold_rows && cold_rows[slot]) {
+        cold_unpack(slot);
+        return 1;
+    }
+    return 0;
+}
+
+/* Free all packed rows and the cold blocks they live in. */
+static void
+cold_release(void)
+{
+    register int i;
+
+    if (cold_rows) {
+        for (i = 0; i < screen.slots; i++) {
+            cold_free(i);
+        }
+        FREE(cold_rows);
+    }
+    if (cold_block) {
+        FREE(cold_block);
+    }
+    if (cold_thawed) {
+        FREE(cold_thawed);
+    }
+    cold_nthawed = cold_thawed_size = 0;
+}
+
+/* Unpack any packed rows from buffer row <row1> through <row2>.  Anything that
+   reads scrollback rows other than through cold_peek() must call this first. */
+void
+scr_thaw_rows(int row1, int row2)
+{
+    register int row, slot;
+
+    if (!cold_rows) {
+        return;
+    }
+    LOWER_BOUND(row1, 0);
+    UPPER_BOUND(row2, screen.slots - 1);
+    for (row = row1; row <= row2; row++) {
+        slot = SCREEN_SLOT(row);
+        if (cold_rows[slot]) {
+            cold_unpack(slot);
+            cold_remember(slot);
+        }
+    }
+}
+
+/* Buffer rows <row1> through <row2> need to be looked at by the next refresh. */
+static void
+scr_dirty_rows(int row1, int row2)
+{
+    register int row;
+
+    for (row = row1; row <= row2; row++) {
+        scr_dirty(row, 0);
+    }
+}
+
+/* Somebody wrote into the rend_t's of buffer rows <row1> through <row2> directly. */
+void
+scr_rend_changed(int row1, int row2)
+{
+    register int row;
+
+    LOWER_BOUND(row1, 0);
+    UPPER_BOUND(row2, screen.slots - 1);
+    for (row = row1; row <= row2; row++) {
+        if (SCREEN_REND(row)) {
+            ROW_RUNS_FORGET(SCREEN_REND(row));
+        }
+    }
+    scr_dirty_rows(row1, row2);
+}
+
 /* Create a new row in the screen buffer and initialize it. */
-inline void blank_screen_mem(text_t **, rend_t **, int, rend_t);
-inline void
+static inline void blank_screen_mem(text_t **, rend_t **, int, rend_t);
+static inline void
 blank_screen_mem(text_t **tp, rend_t **rp, int row, rend_t efs)
 {
-    register unsigned int i = TERM_WINDOW_GET_REPORTED_COLS();
+    register unsigned int i = row_arena.ncol;
     rend_t *r, fs = efs;
 
     if (!tp[row]) {
-        tp[row] = MALLOC(sizeof(text_t) * (TERM_WINDOW_GET_REPORTED_COLS() + 1));
-        rp[row] = MALLOC(sizeof(rend_t) * TERM_WINDOW_GET_REPORTED_COLS());
+        row_alloc(&(tp[row]), &(rp[row]));
     }
     memset(tp[row], ' ', i);
     tp[row][i] = 0;
+    row_runs_fill(rp[row], fs);
     for (r = rp[row]; i--;)
         *r++ = fs;
 }
 
+/* Rotate the scrollback ring back so that buffer row 0 is in slot 0.  This
+   has to happen before screen.text/screen.rend are resized. */
+static void
+scr_unroll_ring(void)
+{
+    register int i, j;
+    cold_row_t **cold;
+
+    if (!screen.head)
+        return;
+    cold = (cold_row_t **) MALLOC(screen.slots * sizeof(cold_row_t *));
+    for (i = 0, j = screen.head; i < screen.slots; i++) {
+        buf_text[i] = screen.text[j];
+        buf_rend[i] = screen.rend[j];
+        cold[i] = cold_rows[j];
+        if (++j == screen.slots)
+            j = 0;
+    }
+    memcpy(screen.text, buf_text, screen.slots * sizeof(text_t *));
+    memcpy(screen.rend, buf_rend, screen.slots * sizeof(rend_t *));
+    FREE(cold_rows);
+    cold_rows = cold;
+    for (i = 0; i < cold_nthawed; i++) {
+        cold_thawed[i] = (cold_thawed[i] - screen.head + screen.slots) % screen.slots;
+    }
+    screen.head = 0;
+}
+
 void
 scr_reset(void)
 {
     int total_rows, prev_total_rows, chscr = 0;
     register int i, j, k;
-    text_t tc;
 
     D_SCREEN(("scr_reset()\n"));
 
@@ -146,6 +826,12 @@ scr_reset(void)
 
     if (TERM_WINDOW_GET_REPORTED_COLS() == prev_ncol && TERM_WINDOW_GET_REPORTED_ROWS() == prev_nrow)
         return;
+    scroll_mixed = 1;
+    dirty_all = 1;
+    if (selection.lazy) {
+        /* The rows are about to be resized; keep the selected text while it's still there. */
+        selection_save();
+    }
 
     if (current_screen != PRIMARY) {
         short tmp = TermWin.nrow;
@@ -180,12 +866,16 @@ scr_reset(void)
         buf_rend = CALLOC(rend_t *, total_rows);
         drawn_rend = CALLOC(rend_t *, TERM_WINDOW_GET_REPORTED_ROWS());
         swap.rend = CALLOC(rend_t *, TERM_WINDOW_GET_REPORTED_ROWS());
+        cold_rows = CALLOC(cold_row_t *, total_rows);
+        screen.head = 0;
+        screen.slots = total_rows;
+        row_arena_init(TERM_WINDOW_GET_REPORTED_COLS());
         D_SCREEN(("screen.text == %8p, screen.rend == %8p, swap.text == %8p, swap.rend == %8p\n",
                   screen.text, screen.rend, swap.text, swap.rend));
 
         for (i = 0; i < TERM_WINDOW_GET_REPORTED_ROWS(); i++) {
             j = i + TermWin.saveLines;
-            blank_screen_mem(screen.text, screen.rend, j, DEFAULT_RSTYLE);
+            blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(j), DEFAULT_RSTYLE);
             blank_screen_mem(swap.text, swap.rend, i, DEFAULT_RSTYLE);
             blank_screen_mem(drawn_text, drawn_rend, i, DEFAULT_RSTYLE);
         }
@@ -201,20 +891,24 @@ scr_reset(void)
             scroll_text(0, prev_nrow - 1, k, 1);
 
             for (i = TERM_WINDOW_GET_REPORTED_ROWS(); i < prev_nrow; i++) {
-                j = i + TermWin.saveLines;
+                j = SCREEN_SLOT(i + TermWin.saveLines);
                 if (screen.text[j]) {
-                    FREE(screen.text[j]);
-                    FREE(screen.rend[j]);
+                    row_free(screen.rend[j]);
+                    screen.text[j] = NULL;
+                    screen.rend[j] = NULL;
                 }
                 if (swap.text[i]) {
-                    FREE(swap.text[i]);
-                    FREE(swap.rend[i]);
+                    row_free(swap.rend[i]);
+                    swap.text[i] = NULL;
+                    swap.rend[i] = NULL;
                 }
                 if (drawn_text[i]) {
-                    FREE(drawn_text[i]);
-                    FREE(drawn_rend[i]);
+                    row_free(drawn_rend[i]);
+                    drawn_text[i] = NULL;
+                    drawn_rend[i] = NULL;
                 }
             }
+            scr_unroll_ring();
             screen.text = REALLOC(screen.text, total_rows * sizeof(text_t *));
             buf_text = REALLOC(buf_text, total_rows * sizeof(text_t *));
             drawn_text = REALLOC(drawn_text, TERM_WINDOW_GET_REPORTED_ROWS() * sizeof(text_t *));
@@ -224,6 +918,8 @@ scr_reset(void)
             buf_rend = REALLOC(buf_rend, total_rows * sizeof(rend_t *));
             drawn_rend = REALLOC(drawn_rend, TERM_WINDOW_GET_REPORTED_ROWS() * sizeof(rend_t *));
             swap.rend = REALLOC(swap.rend, TERM_WINDOW_GET_REPORTED_ROWS() * sizeof(rend_t *));
+            cold_rows = REALLOC(cold_rows, total_rows * sizeof(cold_row_t *));
+            screen.slots = total_rows;
             D_SCREEN(("screen.text == %8p, screen.rend == %8p, swap.text == %8p, swap.rend == %8p\n",
                       screen.text, screen.rend, swap.text, swap.rend));
 
@@ -232,6 +928,7 @@ scr_reset(void)
 
         } else if (TERM_WINDOW_GET_REPORTED_ROWS() > prev_nrow) {
             /* add rows */
+            scr_unroll_ring();
             screen.text = REALLOC(screen.text, total_rows * sizeof(text_t *));
             buf_text = REALLOC(buf_text, total_rows * sizeof(text_t *));
             drawn_text = REALLOC(drawn_text, TERM_WINDOW_GET_REPORTED_ROWS() * sizeof(text_t *));
@@ -241,17 +938,22 @@ scr_reset(void)
             buf_rend = REALLOC(buf_rend, total_rows * sizeof(rend_t *));
             drawn_rend = REALLOC(drawn_rend, TERM_WINDOW_GET_REPORTED_ROWS() * sizeof(rend_t *));
             swap.rend = REALLOC(swap.rend, TERM_WINDOW_GET_REPORTED_ROWS() * sizeof(rend_t *));
+            cold_rows = REALLOC(cold_rows, total_rows * sizeof(cold_row_t *));
+            screen.slots = total_rows;
             D_SCREEN(("screen.text == %8p, screen.rend == %8p, swap.text == %8p, swap.rend == %8p\n",
                       screen.text, screen.rend, swap.text, swap.rend));
 
+            /* The ring was just unrolled, so slots and buffer rows coincide here. */
             k = MIN(TermWin.nscrolled, TERM_WINDOW_GET_REPORTED_ROWS() - prev_nrow);
             for (i = prev_total_rows; i < total_rows - k; i++) {
                 screen.text[i] = NULL;
+                cold_rows[i] = NULL;
                 blank_screen_mem(screen.text, screen.rend, i, DEFAULT_RSTYLE);
             }
             for ( /* i = total_rows - k */ ; i < total_rows; i++) {
                 screen.text[i] = NULL;
                 screen.rend[i] = NULL;
+                cold_rows[i] = NULL;
             }
             for (i = prev_nrow; i < TERM_WINDOW_GET_REPORTED_ROWS(); i++) {
                 swap.text[i] = NULL;
@@ -260,45 +962,22 @@ scr_reset(void)
                 blank_screen_mem(drawn_text, drawn_rend, i, DEFAULT_RSTYLE);
             }
             if (k > 0) {
+                /* These scrollback rows are about to become screen rows. */
+                scr_thaw_rows(TermWin.saveLines - k, TermWin.saveLines - 1);
                 scroll_text(0, TERM_WINDOW_GET_REPORTED_ROWS() - 1, -k, 1);
                 screen.row += k;
                 TermWin.nscrolled -= k;
                 for (i = TermWin.saveLines - TermWin.nscrolled; k--; i--) {
-                    if (!screen.text[i]) {
-                        blank_screen_mem(screen.text, screen.rend, i, DEFAULT_RSTYLE);
+                    cold_free(SCREEN_SLOT(i));
+                    if (!SCREEN_TEXT(i)) {
+                        blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(i), DEFAULT_RSTYLE);
                     }
                 }
             }
         }
         /* B2: resize columns */
         if (TERM_WINDOW_GET_REPORTED_COLS() != prev_ncol) {
-            for (i = 0; i < total_rows; i++) {
-                if (screen.text[i]) {
-                    tc = screen.text[i][prev_ncol];
-                    screen.text[i] = REALLOC(screen.text[i], (TERM_WINDOW_GET_REPORTED_COLS() + 1) * sizeof(text_t));
-                    screen.rend[i] = REALLOC(screen.rend[i], TERM_WINDOW_GET_REPORTED_COLS() * sizeof(rend_t));
-                    screen.text[i][TERM_WINDOW_GET_REPORTED_COLS()] = MIN(tc, TERM_WINDOW_GET_REPORTED_COLS());
-                    if (TERM_WINDOW_GET_REPORTED_COLS() > prev_ncol)
-                        blank_line(&(screen.text[i][prev_ncol]), &(screen.rend[i][prev_ncol]),
-                                   TERM_WINDOW_GET_REPORTED_COLS() - prev_ncol, DEFAULT_RSTYLE);
-                }
-            }
-            for (i = 0; i < TERM_WINDOW_GET_REPORTED_ROWS(); i++) {
-                drawn_text[i] = REALLOC(drawn_text[i], (TERM_WINDOW_GET_REPORTED_COLS() + 1) * sizeof(text_t));
-                drawn_rend[i] = REALLOC(drawn_rend[i], TERM_WINDOW_GET_REPORTED_COLS() * sizeof(rend_t));
-                if (swap.text[i]) {
-                    tc = swap.text[i][prev_ncol];
-                    swap.text[i] = REALLOC(swap.text[i], (TERM_WINDOW_GET_REPORTED_COLS() + 1) * sizeof(text_t));
-                    swap.rend[i] = REALLOC(swap.rend[i], TERM_WINDOW_GET_REPORTED_COLS() * sizeof(rend_t));
-                    swap.text[i][TERM_WINDOW_GET_REPORTED_COLS()] = MIN(tc, TERM_WINDOW_GET_REPORTED_COLS());
-                    if (TERM_WINDOW_GET_REPORTED_COLS() > prev_ncol)
-                        blank_line(&(swap.text[i][prev_ncol]), &(swap.rend[i][prev_ncol]),
-                                   TERM_WINDOW_GET_REPORTED_COLS() - prev_ncol, DEFAULT_RSTYLE);
-                }
-                if (TERM_WINDOW_GET_REPORTED_COLS() > prev_ncol)
-                    blank_line(&(drawn_text[i][prev_ncol]), &(drawn_rend[i][prev_ncol]),
-                               TERM_WINDOW_GET_REPORTED_COLS() - prev_ncol, DEFAULT_RSTYLE);
-            }
+            row_arena_resize(TERM_WINDOW_GET_REPORTED_COLS());
         }
         if (tabs)
             FREE(tabs);
@@ -308,6 +987,16 @@ scr_reset(void)
     for (i = 0; i < TERM_WINDOW_GET_REPORTED_COLS(); i++)
         tabs[i] = (i % TABSIZE == 0) ? 1 : 0;
 
+    if (dirty_nrow != TERM_WINDOW_GET_REPORTED_ROWS()) {
+        if (dirty_rows) {
+            FREE(dirty_rows);
+            FREE(dirty_col);
+        }
+        dirty_nrow = TERM_WINDOW_GET_REPORTED_ROWS();
+        dirty_rows = CALLOC(unsigned long, (dirty_nrow + DIRTY_BITS - 1) / DIRTY_BITS);
+        dirty_col = CALLOC(int, dirty_nrow);
+    }
+
     prev_nrow = TERM_WINDOW_GET_REPORTED_ROWS();
     prev_ncol = TERM_WINDOW_GET_REPORTED_COLS();
 
@@ -321,26 +1010,15 @@ scr_reset(void)
 void
 scr_release(void)
 {
-    int total_rows;
-    register int i;
-
-    total_rows = TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines;
-    for (i = 0; i < total_rows; i++) {
-        if (screen.text[i]) {
-            FREE(screen.text[i]);
-            FREE(screen.rend[i]);
-        }
-    }
-    for (i = 0; i < TERM_WINDOW_GET_REPORTED_ROWS(); i++) {
-        FREE(drawn_text[i]);
-        FREE(drawn_rend[i]);
-        FREE(swap.text[i]);
-        FREE(swap.rend[i]);
-    }
+    cold_release();
+    row_arena_release();
     FREE(screen.text);
     FREE(screen.rend);
     FREE(drawn_text);
     FREE(drawn_rend);
+    FREE(dirty_rows);
+    FREE(dirty_col);
+    dirty_nrow = 0;
     FREE(swap.text);
     FREE(swap.rend);
     FREE(buf_text);
@@ -379,6 +1057,9 @@ scr_poweron(void)
     screen.flags = Screen_DefaultFlags;
 
     scr_cursor(SAVE);
+    if (selection.lazy) {
+        selection_save();
+    }
     TermWin.nscrolled = 0;
     scr_reset();
     scr_refresh(SLOW_REFRESH);
@@ -432,6 +1113,11 @@ scr_change_screen(int scrn)
 
     if (current_screen == scrn)
         return current_screen;
+    dirty_all = 1;
+    if (selection.lazy) {
+        /* The selected rows are about to trade places with the other screen's. */
+        selection_save();
+    }
 
     SWAP_IT(current_screen, scrn, tmp);
 #if NSCREENS
@@ -440,8 +1126,8 @@ scr_change_screen(int scrn)
         if (!screen.text || !screen.rend)
             return (current_screen);
         for (i = TERM_WINDOW_GET_REPORTED_ROWS(); i--;) {
-            SWAP_IT(screen.text[i + offset], swap.text[i], t0);
-            SWAP_IT(screen.rend[i + offset], swap.rend[i], r0);
+            SWAP_IT(SCREEN_TEXT(i + offset), swap.text[i], t0);
+            SWAP_IT(SCREEN_REND(i + offset), swap.rend[i], r0);
         }
         SWAP_IT(screen.row, swap.row, tmp);
         SWAP_IT(screen.col, swap.col, tmp);
@@ -455,8 +1141,8 @@ scr_change_screen(int scrn)
     if (current_screen == PRIMARY) {
         scroll_text(0, (TERM_WINDOW_GET_REPORTED_ROWS() - 1), TERM_WINDOW_GET_REPORTED_ROWS(), 0);
         for (i = TermWin.saveLines; i < TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines; i++)
-            if (!screen.text[i]) {
-                blank_screen_mem(screen.text, screen.rend, i, DEFAULT_RSTYLE);
+            if (!SCREEN_TEXT(i)) {
+                blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(i), DEFAULT_RSTYLE);
             }
     }
 # endif
@@ -597,6 +1283,22 @@ scroll_text(int row1, int row2, int count, int spec)
 
     if (count == 0 || (row1 > row2))
         return 0;
+    if (spec) {
+        dirty_all = 1;
+    } else {
+        scr_dirty_rows(row1 + TermWin.saveLines, row2 + TermWin.saveLines);
+    }
+    if (spec || TermWin.view_start) {
+        scroll_mixed = 1;
+    } else if (!scroll_count) {
+        scroll_top = row1;
+        scroll_bot = row2;
+        scroll_count = count;
+    } else if (row1 == scroll_top && row2 == scroll_bot) {
+        scroll_count += count;
+    } else {
+        scroll_mixed = 1;
+    }
     if ((count > 0) && (row1 == 0) && (current_screen == PRIMARY)) {
         TermWin.nscrolled += count;
         UPPER_BOUND(TermWin.nscrolled, TermWin.saveLines);
@@ -604,6 +1306,19 @@ scroll_text(int row1, int row2, int count, int spec)
         row1 += TermWin.saveLines;
     row2 += TermWin.saveLines;
 
+    if (selection.lazy && current_screen == selection.screen) {
+        /* A lazy selection moves with its rows, unless some of them are about to be lost. */
+        i = selection.text_beg.row + TermWin.saveLines;
+        j = selection.text_end.row + TermWin.saveLines;
+        if (j < row1 || i > row2) {
+            /* Not in the scrolling region. */
+        } else if (i >= row1 && j <= row2 && i - count >= row1 && j - count <= row2) {
+            selection.text_beg.row -= count;
+            selection.text_end.row -= count;
+        } else {
+            selection_save();
+        }
+    }
     if (selection.op && current_screen == selection.screen) {
         i = selection.beg.row + TermWin.saveLines;
         j = selection.end.row + TermWin.saveLines;
@@ -632,26 +1347,48 @@ scroll_text(int row1, int row2, int count, int spec)
 
 /* A1: Copy and blank out lines that will get clobbered by the rotation */
         for (i = 0, j = row1; i < count; i++, j++) {
-            buf_text[i] = screen.text[j];
-            buf_rend[i] = screen.rend[j];
+            cold_free(SCREEN_SLOT(j));
+            buf_text[i] = SCREEN_TEXT(j);
+            buf_rend[i] = SCREEN_REND(j);
             if (!buf_text[i]) {
-                /* A new ALLOC is done with size ncol and
-                   blankline with size prev_ncol -- Sebastien van K */
-                buf_text[i] = MALLOC(sizeof(text_t) * (prev_ncol + 1));
-                buf_rend[i] = MALLOC(sizeof(rend_t) * prev_ncol);
+                row_alloc(&(buf_text[i]), &(buf_rend[i]));
             }
-            blank_line(buf_text[i], buf_rend[i], prev_ncol, DEFAULT_RSTYLE);
-            buf_text[i][prev_ncol] = 0;
+            /* Not TermWin.ncol; scr_reset() may not have resized the rows yet. */
+            blank_line(buf_text[i], buf_rend[i], row_arena.ncol, DEFAULT_RSTYLE);
+            row_runs_fill(buf_rend[i], DEFAULT_RSTYLE);
+            buf_text[i][row_arena.ncol] = 0;
         }
+        if (row1 == 0) {
+/* A2: Rotate the whole ring by moving its head.  The clobbered lines come back around at the bottom. */
+            for (i = 0, j = 0; i < count; i++, j++) {
+                SCREEN_TEXT(j) = buf_text[i];
+                SCREEN_REND(j) = buf_rend[i];
+            }
+            screen.head = (screen.head + count) % screen.slots;
+            if (row2 < screen.slots - 1) {
+/* A3: Lines below the region moved too, so put them back under the resurrected lines. */
+                for (j = row2 + 1; j < screen.slots; i++, j++) {
+                    buf_text[i] = SCREEN_TEXT(j - count);
+                    buf_rend[i] = SCREEN_REND(j - count);
+                }
+                for (i = 0, j = row2 - count + 1; j < screen.slots; i++, j++) {
+                    SCREEN_TEXT(j) = buf_text[i];
+                    SCREEN_REND(j) = buf_rend[i];
+                }
+            }
+/* A4: Pack up the lines that just went cold */
+            cold_advance(count);
+        } else {
 /* A2: Rotate lines */
-        for (j = row1; (j + count) <= row2; j++) {
-            screen.text[j] = screen.text[j + count];
-            screen.rend[j] = screen.rend[j + count];
-        }
+            for (j = row1; (j + count) <= row2; j++) {
+                SCREEN_TEXT(j) = SCREEN_TEXT(j + count);
+                SCREEN_REND(j) = SCREEN_REND(j + count);
+            }
 /* A3: Resurrect lines */
-        for (i = 0; i < count; i++, j++) {
-            screen.text[j] = buf_text[i];
-            screen.rend[j] = buf_rend[i];
+            for (i = 0; i < count; i++, j++) {
+                SCREEN_TEXT(j) = buf_text[i];
+                SCREEN_REND(j) = buf_rend[i];
+            }
         }
     } else if (count < 0) {
 /* B: scroll down */
@@ -659,26 +1396,36 @@ scroll_text(int row1, int row2, int count, int spec)
         count = MIN(-count, row2 - row1 + 1);
 /* B1: Copy and blank out lines that will get clobbered by the rotation */
         for (i = 0, j = row2; i < count; i++, j--) {
-            buf_text[i] = screen.text[j];
-            buf_rend[i] = screen.rend[j];
+            cold_free(SCREEN_SLOT(j));
+            buf_text[i] = SCREEN_TEXT(j);
+            buf_rend[i] = SCREEN_REND(j);
             if (!buf_text[i]) {
-                /* A new ALLOC is done with size ncol and
-                   blankline with size prev_ncol -- Sebastien van K */
-                buf_text[i] = MALLOC(sizeof(text_t) * (prev_ncol + 1));
-                buf_rend[i] = MALLOC(sizeof(rend_t) * prev_ncol);
+                row_alloc(&(buf_text[i]), &(buf_rend[i]));
             }
-            blank_line(buf_text[i], buf_rend[i], prev_ncol, DEFAULT_RSTYLE);
-            buf_text[i][prev_ncol] = 0;
+            /* Not TermWin.ncol; scr_reset() may not have resized the rows yet. */
+            blank_line(buf_text[i], buf_rend[i], row_arena.ncol, DEFAULT_RSTYLE);
+            row_runs_fill(buf_rend[i], DEFAULT_RSTYLE);
+            buf_text[i][row_arena.ncol] = 0;
         }
+        if (row1 == 0 && row2 == screen.slots - 1) {
+/* B2: Rotate the whole ring by moving its head back */
+            screen.head = (screen.head + screen.slots - count) % screen.slots;
+/* B3: The clobbered lines are already on top now; just store back any that B1 allocated */
+            for (i = 0, j = count - 1; i < count; i++, j--) {
+                SCREEN_TEXT(j) = buf_text[i];
+                SCREEN_REND(j) = buf_rend[i];
+            }
+        } else {
 /* B2: Rotate lines */
-        for (j = row2; (j - count) >= row1; j--) {
-            screen.text[j] = screen.text[j - count];
-            screen.rend[j] = screen.rend[j - count];
-        }
+            for (j = row2; (j - count) >= row1; j--) {
+                SCREEN_TEXT(j) = SCREEN_TEXT(j - count);
+                SCREEN_REND(j) = SCREEN_REND(j - count);
+            }
 /* B3: Resurrect lines */
-        for (i = 0, j = row1; i < count; i++, j++) {
-            screen.text[j] = buf_text[i];
-            screen.rend[j] = buf_rend[i];
+            for (i = 0, j = row1; i < count; i++, j++) {
+                SCREEN_TEXT(j) = buf_text[i];
+                SCREEN_REND(j) = buf_rend[i];
+            }
         }
         count = -count;
     }
@@ -719,22 +1466,24 @@ scr_add_lines(const unsigned char *str, int nlines, int len)
             for (i = nlines, row = screen.bscroll + TermWin.saveLines + 1; row > 0 && i--;) {
                 /* Move row-- to beginning of loop to avoid segfault. -- added by Sebastien van K */
                 row--;
-                blank_screen_mem(screen.text, screen.rend, row, rstyle);
+                blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(row), rstyle);
             }
             screen.row -= nlines;
         }
     }
     UPPER_BOUND(screen.col, last_col - 1);
     BOUND(screen.row, -TermWin.nscrolled, TERM_WINDOW_GET_REPORTED_ROWS() - 1);
+    SELECTION_SAVE(screen.row, TERM_WINDOW_GET_REPORTED_ROWS() - 1);
 
     row = screen.row + TermWin.saveLines;
-    if (!screen.text[row]) {
-        blank_screen_mem(screen.text, screen.rend, row, DEFAULT_RSTYLE);
+    if (!SCREEN_TEXT(row)) {
+        blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(row), DEFAULT_RSTYLE);
+        scr_dirty(row, 0);
     }                           /* avoid segfault -- added by Sebastien van K */
     beg.row = screen.row;
     beg.col = screen.col;
-    stp = screen.text[row];
-    srp = screen.rend[row];
+    stp = SCREEN_TEXT(row);
+    srp = SCREEN_REND(row);
 
 #ifdef MULTI_CHARSET
     if (lost_multi && screen.col > 0 && ((srp[screen.col - 1] & RS_multiMask) == RS_multi1)
@@ -743,6 +1492,36 @@ scr_add_lines(const unsigned char *str, int nlines, int len)
 #endif
 
     for (i = 0; i < len;) {
+        /* Plain printable text needs none of the per-character handling below, so copy
+           as much of it as fits on this row in one go. */
+        if (!(screen.flags & (Screen_WrapNext | Screen_Insert))
+#ifdef MULTI_CHARSET
+            && chstat == SBYTE && !((encoding_method != LATIN1) && multi_byte)
+#endif
+            ) {
+            for (j = i; j < len && j - i < last_col - screen.col && str[j] >= ' ' && str[j] <= '~'; j++);
+            if (j > i) {
+#ifdef MULTI_CHARSET
+                rstyle &= ~RS_multiMask;
+#endif
+                j -= i;
+                memcpy(stp + screen.col, str + i, j);
+                row_runs_span(srp, screen.col, j, rstyle);
+                scr_dirty(row, screen.col);
+                i += j;
+                if (screen.col + j < last_col) {
+                    screen.col += j;
+                } else {
+                    screen.col = last_col - 1;
+                    stp[last_col] = last_col;
+                    if (screen.flags & Screen_Autowrap)
+                        screen.flags |= Screen_WrapNext;
+                    else
+                        screen.flags &= ~Screen_WrapNext;
+                }
+                continue;
+            }
+        }
         c = str[i++];
 #ifdef MULTI_CHARSET
         if ((encoding_method != LATIN1) && (chstat == WBYTE)) {
@@ -773,13 +1552,13 @@ scr_add_lines(const unsigned char *str, int nlines, int len)
                         if (screen.row == screen.bscroll) {
                             scroll_text(screen.tscroll, screen.bscroll, 1, 0);
                             j = screen.bscroll + TermWin.saveLines;
-                            blank_screen_mem(screen.text, screen.rend, j, rstyle & ~(RS_Uline | RS_Overscore));
+                            blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(j), rstyle & ~(RS_Uline | RS_Overscore));
                         } else if (screen.row < (TERM_WINDOW_GET_REPORTED_ROWS() - 1)) {
                             screen.row++;
                             row = screen.row + TermWin.saveLines;
                         }
-                        stp = screen.text[row]; /* _must_ refresh */
-                        srp = screen.rend[row]; /* _must_ refresh */
+                        stp = SCREEN_TEXT(row); /* _must_ refresh */
+                        srp = SCREEN_REND(row); /* _must_ refresh */
                         continue;
                     case '\r':
                         LOWER_BOUND(stp[last_col], screen.col);
@@ -802,20 +1581,22 @@ scr_add_lines(const unsigned char *str, int nlines, int len)
                 j = screen.bscroll + TermWin.saveLines;
                 /* blank_line(screen.text[j], screen.rend[j], TermWin.ncol,
                    rstyle);    Bug fix from John Ellison - need to reset rstyle */
-                blank_screen_mem(screen.text, screen.rend, j, rstyle & ~(RS_Uline | RS_Overscore));
+                blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(j), rstyle & ~(RS_Uline | RS_Overscore));
             } else if (screen.row < (TERM_WINDOW_GET_REPORTED_ROWS() - 1)) {
                 screen.row++;
                 row = screen.row + TermWin.saveLines;
             }
-            stp = screen.text[row];     /* _must_ refresh */
-            srp = screen.rend[row];     /* _must_ refresh */
+            stp = SCREEN_TEXT(row);     /* _must_ refresh */
+            srp = SCREEN_REND(row);     /* _must_ refresh */
             screen.col = 0;
             screen.flags &= ~Screen_WrapNext;
         }
         if (screen.flags & Screen_Insert)
             scr_insdel_chars(1, INSERT);
         stp[screen.col] = c;
-        srp[screen.col] = rstyle;
+        if (srp[screen.col] != rstyle)
+            row_runs_set(srp, screen.col, rstyle);
+        scr_dirty(row, screen.col);
         if (screen.col < (last_col - 1))
             screen.col++;
         else {
@@ -972,7 +1753,7 @@ scr_index(int direction)
             dirn = screen.bscroll + TermWin.saveLines;
         else
             dirn = screen.tscroll + TermWin.saveLines;
-        blank_screen_mem(screen.text, screen.rend, dirn, rstyle);
+        blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(dirn), rstyle);
     } else
         screen.row += dirn;
     BOUND(screen.row, 0, TERM_WINDOW_GET_REPORTED_ROWS() - 1);
@@ -1000,13 +1781,14 @@ scr_erase_line(int mode)
 
     row = TermWin.saveLines + screen.row;
     ASSERT(row < TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines);
+    SELECTION_SAVE(screen.row, screen.row);
 
-    if (screen.text[row]) {
+    if (SCREEN_TEXT(row)) {
         switch (mode) {
             case 0:            /* erase to end of line */
                 col = screen.col;
                 num = TERM_WINDOW_GET_REPORTED_COLS() - col;
-                UPPER_BOUND(screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()], col);
+                UPPER_BOUND(SCREEN_TEXT(row)[TERM_WINDOW_GET_REPORTED_COLS()], col);
                 break;
             case 1:            /* erase to beginning of line */
                 col = 0;
@@ -1015,14 +1797,17 @@ scr_erase_line(int mode)
             case 2:            /* erase whole line */
                 col = 0;
                 num = TERM_WINDOW_GET_REPORTED_COLS();
-                screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()] = 0;
+                SCREEN_TEXT(row)[TERM_WINDOW_GET_REPORTED_COLS()] = 0;
                 break;
             default:
                 return;
         }
-        blank_line(&(screen.text[row][col]), &(screen.rend[row][col]), num, rstyle & ~(RS_Uline | RS_Overscore));
+        blank_line(&(SCREEN_TEXT(row)[col]), &(SCREEN_REND(row)[col]), num, rstyle & ~(RS_Uline | RS_Overscore));
+        ROW_RUNS_FORGET(SCREEN_REND(row));
+        scr_dirty(row, col);
     } else {
-        blank_screen_mem(screen.text, screen.rend, row, rstyle & ~(RS_Uline | RS_Overscore));
+        blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(row), rstyle & ~(RS_Uline | RS_Overscore));
+        scr_dirty(row, 0);
     }
 }
 
@@ -1052,6 +1837,7 @@ scr_erase_screen(int mode)
     D_SCREEN(("scr_erase_screen(%d) at screen row: %d\n", mode, screen.row));
     REFRESH_ZERO_SCROLLBACK;
     RESET_CHSTAT;
+    SELECTION_SAVE(0, TERM_WINDOW_GET_REPORTED_ROWS() - 1);
     row_offset = TermWin.saveLines;
 
 
@@ -1092,8 +1878,9 @@ scr_erase_screen(int mode)
             }
         }
         for (; num--; row++) {
-            blank_screen_mem(screen.text, screen.rend, row + row_offset, rstyle & ~(RS_RVid | RS_Uline | RS_Overscore));
+            blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(row + row_offset), rstyle & ~(RS_RVid | RS_Uline | RS_Overscore));
             blank_screen_mem(drawn_text, drawn_rend, row, ren);
+            DIRTY_ROW(row, 0);
         }
     }
 }
@@ -1111,11 +1898,14 @@ scr_E(void)
 
     ZERO_SCROLLBACK;
     RESET_CHSTAT;
+    SELECTION_SAVE(0, TERM_WINDOW_GET_REPORTED_ROWS() - 1);
+    dirty_all = 1;
 
     fs = rstyle;
     for (i = TermWin.saveLines; i < TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines; i++) {
-        t = screen.text[i];
-        r = screen.rend[i];
+        t = SCREEN_TEXT(i);
+        r = SCREEN_REND(i);
+        row_runs_fill(r, fs);
         for (j = 0; j < TERM_WINDOW_GET_REPORTED_COLS(); j++) {
             *t++ = 'E';
             *r++ = fs;
@@ -1157,7 +1947,7 @@ scr_insdel_lines(int count, int insdel)
         end = screen.row + count - 1 + TermWin.saveLines;
     }
     for (; count--; end--) {
-        blank_screen_mem(screen.text, screen.rend, end, rstyle);
+        blank_screen_mem(screen.text, screen.rend, SCREEN_SLOT(end), rstyle);
     }
 }
 
@@ -1168,6 +1958,8 @@ void
 scr_insdel_chars(int count, int insdel)
 {
     int col, row;
+    text_t *stp;
+    rend_t *srp;
 
     ZERO_SCROLLBACK;
     RESET_CHSTAT;
@@ -1176,43 +1968,49 @@ scr_insdel_chars(int count, int insdel)
         return;
 
     CHECK_SELECTION;
+    SELECTION_SAVE(screen.row, screen.row);
     UPPER_BOUND(count, (TERM_WINDOW_GET_REPORTED_COLS() - screen.col));
 
     row = screen.row + TermWin.saveLines;
+    stp = SCREEN_TEXT(row);
+    srp = SCREEN_REND(row);
     screen.flags &= ~Screen_WrapNext;
 
     switch (insdel) {
         case INSERT:
             for (col = TERM_WINDOW_GET_REPORTED_COLS() - 1; (col - count) >= screen.col; col--) {
-                screen.text[row][col] = screen.text[row][col - count];
-                screen.rend[row][col] = screen.rend[row][col - count];
+                stp[col] = stp[col - count];
+                srp[col] = srp[col - count];
             }
-            screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()] += count;
-            UPPER_BOUND(screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()], TERM_WINDOW_GET_REPORTED_COLS());
+            stp[TERM_WINDOW_GET_REPORTED_COLS()] += count;
+            UPPER_BOUND(stp[TERM_WINDOW_GET_REPORTED_COLS()], TERM_WINDOW_GET_REPORTED_COLS());
             /* FALLTHROUGH */
         case ERASE:
-            blank_line(&(screen.text[row][screen.col]), &(screen.rend[row][screen.col]), count, rstyle);
+            blank_line(&(stp[screen.col]), &(srp[screen.col]), count, rstyle);
             break;
         case DELETE:
             for (col = screen.col; (col + count) < TERM_WINDOW_GET_REPORTED_COLS(); col++) {
-                screen.text[row][col] = screen.text[row][col + count];
-                screen.rend[row][col] = screen.rend[row][col + count];
-            }
-            blank_line(&(screen.text[row][TERM_WINDOW_GET_REPORTED_COLS() - count]),
-                       &(screen.rend[row][TERM_WINDOW_GET_REPORTED_COLS() - count]), count, rstyle);
-            screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()] -= count;
-            if (((signed char) screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()]) < 0)
-                screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()] = 0;
+                stp[col] = stp[col + count];
+                srp[col] = srp[col + count];
+            }
+            blank_line(&(stp[TERM_WINDOW_GET_REPORTED_COLS() - count]),
+                       &(srp[TERM_WINDOW_GET_REPORTED_COLS() - count]), count, rstyle);
+            stp[TERM_WINDOW_GET_REPORTED_COLS()] -= count;
+            if (((signed char) stp[TERM_WINDOW_GET_REPORTED_COLS()]) < 0)
+                stp[TERM_WINDOW_GET_REPORTED_COLS()] = 0;
             break;
     }
+    ROW_RUNS_FORGET(srp);
+    scr_dirty(row, screen.col);
 #ifdef MULTI_CHARSET
-    if ((screen.rend[row][0] & RS_multiMask) == RS_multi2) {
-        screen.rend[row][0] &= ~RS_multiMask;
-        screen.text[row][0] = ' ';
+    if ((srp[0] & RS_multiMask) == RS_multi2) {
+        srp[0] &= ~RS_multiMask;
+        stp[0] = ' ';
+        scr_dirty(row, 0);
     }
-    if ((screen.rend[row][TERM_WINDOW_GET_REPORTED_COLS() - 1] & RS_multiMask) == RS_multi1) {
-        screen.rend[row][TERM_WINDOW_GET_REPORTED_COLS() - 1] &= ~RS_multiMask;
-        screen.text[row][TERM_WINDOW_GET_REPORTED_COLS() - 1] = ' ';
+    if ((srp[TERM_WINDOW_GET_REPORTED_COLS() - 1] & RS_multiMask) == RS_multi1) {
+        srp[TERM_WINDOW_GET_REPORTED_COLS() - 1] &= ~RS_multiMask;
+        stp[TERM_WINDOW_GET_REPORTED_COLS() - 1] = ' ';
     }
 #endif
 }
@@ -1325,9 +2123,12 @@ scr_rvideo_mode(int mode)
         rstyle ^= RS_RVid;
 
         maxlines = TermWin.saveLines + TERM_WINDOW_GET_REPORTED_ROWS();
-        for (i = TermWin.saveLines; i < maxlines; i++)
+        for (i = TermWin.saveLines; i < maxlines; i++) {
             for (j = 0; j < TERM_WINDOW_GET_REPORTED_COLS(); j++)
-                screen.rend[i][j] ^= RS_RVid;
+                SCREEN_REND(i)[j] ^= RS_RVid;
+            ROW_RUNS_FORGET(SCREEN_REND(i));
+        }
+        dirty_all = 1;
         scr_refresh(SLOW_REFRESH);
     }
 }
@@ -1511,6 +2312,7 @@ scr_expose(int x, int y, int width, int height)
 
     for (i = rect_beg.row; i <= rect_end.row; i++) {
         memset(&(drawn_text[i][rect_beg.col]), 0, rect_end.col - rect_beg.col + 1);
+        DIRTY_ROW(i, rect_beg.col);
     }
 }
 
@@ -1577,7 +2379,7 @@ void
 scr_printscreen(int fullhist)
 {
 #ifdef PRINTPIPE
-    int i, r, nrows, row_offset;
+    int i, r, nrows, row_offset, packed;
     text_t *t;
     FILE *fd;
 
@@ -1593,38 +2395,225 @@ scr_printscreen(int fullhist)
         row_offset = TermWin.saveLines - TermWin.view_start;
     }
 
-    for (r = 0; r < nrows; r++) {
-        t = screen.text[r + row_offset];
-        for (i = TERM_WINDOW_GET_REPORTED_COLS() - 1; i >= 0; i--)
-            if (!isspace(t[i]))
-                break;
-        fprintf(fd, "%.*s\n", (i + 1), t);
+    for (r = 0; r < nrows; r++) {
+        packed = cold_peek(r + row_offset);
+        t = SCREEN_TEXT(r + row_offset);
+        for (i = TERM_WINDOW_GET_REPORTED_COLS() - 1; i >= 0; i--)
+            if (!isspace(t[i]))
+                break;
+        fprintf(fd, "%.*s\n", (i + 1), t);
+        if (packed)
+            cold_pack(r + row_offset);
+    }
+    pclose_printer(fd);
+#endif
+}
+
+#ifdef MULTI_CHARSET
+int
+scr_multi1(void)
+{
+    rend_t rend;
+
+    rend = SCREEN_REND(screen.row + TermWin.saveLines)[screen.col];
+    return ((rend & RS_multiMask) == RS_multi1);
+}
+
+int
+scr_multi2(void)
+{
+    rend_t rend;
+
+    if (screen.col == 0)
+        return 0;
+    rend = SCREEN_REND(screen.row + TermWin.saveLines)[screen.col - 1];
+    return ((rend & RS_multiMask) == RS_multi2);
+}
+#endif /* MULTI_CHARSET */
+
+/* Add the box from (<x1>, <y1>) to (<x2>, <y2>) to the damage list. */
+static void
+scr_damage(int x1, int y1, int x2, int y2)
+{
+    register int i, best;
+    int ux1, uy1, ux2, uy2;
+    long slack, grow, least;
+
+    if (x2 < x1) {
+        SWAP_IT(x1, x2, i);
+    }
+    if (y2 < y1) {
+        SWAP_IT(y1, y2, i);
+    }
+    /* merging is worth it if it adds no more than about a character cell of area */
+    slack = (long) TermWin.fwidth * TermWin.fheight;
+    for (;;) {
+        best = -1;
+        least = 0;
+        for (i = 0; i < ndamage; i++) {
+            ux1 = MIN(x1, damage[i].x1);
+            uy1 = MIN(y1, damage[i].y1);
+            ux2 = MAX(x2, damage[i].x2);
+            uy2 = MAX(y2, damage[i].y2);
+            grow = DAMAGE_AREA(ux1, uy1, ux2, uy2) - DAMAGE_AREA(x1, y1, x2, y2)
+                - DAMAGE_AREA(damage[i].x1, damage[i].y1, damage[i].x2, damage[i].y2);
+            if (best < 0 || grow < least) {
+                best = i;
+                least = grow;
+            }
+        }
+        if (best < 0 || (least > slack && ndamage < DAMAGE_MAX)) {
+            break;
+        }
+        /* take the box out and keep going with the union, which may now touch others */
+        x1 = MIN(x1, damage[best].x1);
+        y1 = MIN(y1, damage[best].y1);
+        x2 = MAX(x2, damage[best].x2);
+        y2 = MAX(y2, damage[best].y2);
+        damage[best] = damage[--ndamage];
+    }
+    damage[ndamage].x1 = x1;
+    damage[ndamage].y1 = y1;
+    damage[ndamage].x2 = x2;
+    damage[ndamage].y2 = y2;
+    ndamage++;
+}
+
+/* Send whatever is waiting in draw_queue. */
+static void
+draw_queue_flush(void)
+{
+    if (draw_queue.nitems) {
+        D_SCREEN(("Drawing %d text items in one request.\n", draw_queue.nitems));
+        XDrawText(Xdisplay, draw_queue.d, TermWin.gc, draw_queue.x, draw_queue.y, draw_queue.items, draw_queue.nitems);
+    }
+    if (draw_queue.nsegs) {
+        XDrawSegments(Xdisplay, draw_queue.d, TermWin.gc, draw_queue.segs, draw_queue.nsegs);
+    }
+    draw_queue.nitems = draw_queue.nsegs = draw_queue.len = 0;
+}
+
+/* Queue <len> characters of <str>, in <font>, at (<x>, <y>) on <d>. */
+static void
+draw_queue_text(Drawable d, XFontStruct *font, int x, int y, const char *str, int len)
+{
+    XTextItem *item;
+
+    if ((draw_queue.nitems || draw_queue.nsegs)
+        && (d != draw_queue.d || (draw_queue.nitems && y != draw_queue.y) || draw_queue.nitems == DRAW_QUEUE_LEN
+            || draw_queue.len + len > (int) sizeof(draw_queue.text))) {
+        draw_queue_flush();
+    }
+    draw_queue.d = d;
+    if (!draw_queue.nitems) {
+        draw_queue.x = draw_queue.end = x;
+        draw_queue.y = y;
+    }
+    item = &draw_queue.items[draw_queue.nitems++];
+    item->chars = draw_queue.text + draw_queue.len;
+    item->nchars = len;
+    item->delta = x - draw_queue.end;
+    item->font = None;
+    memcpy(item->chars, str, len);
+    draw_queue.len += len;
+    draw_queue.end = x + XTextWidth(font, str, len);
+}
+
+/* Queue a line from (<x1>, <y1>) to (<x2>, <y2>) on <d>. */
+static void
+draw_queue_line(Drawable d, int x1, int y1, int x2, int y2)
+{
+    XSegment *seg;
+
+    if ((draw_queue.nitems || draw_queue.nsegs) && (d != draw_queue.d || draw_queue.nsegs == DRAW_QUEUE_LEN)) {
+        draw_queue_flush();
     }
-    pclose_printer(fd);
-#endif
+    draw_queue.d = d;
+    seg = &draw_queue.segs[draw_queue.nsegs++];
+    seg->x1 = x1;
+    seg->y1 = y1;
+    seg->x2 = x2;
+    seg->y2 = y2;
 }
 
-#ifdef MULTI_CHARSET
-int
-scr_multi1(void)
+/* Set the foreground, background, and/or font of TermWin.gc, sending only what's different.
+   Anything still queued was meant to be drawn with the old values, so it goes first. */
+static void
+scr_gc_change(unsigned long mask, XGCValues *values)
 {
-    rend_t rend;
+    unsigned long changed = 0;
 
-    rend = screen.rend[screen.row + TermWin.saveLines][screen.col];
-    return ((rend & RS_multiMask) == RS_multi1);
+    if ((mask & GCForeground) && values->foreground != gc_state.foreground) {
+        gc_state.foreground = values->foreground;
+        changed |= GCForeground;
+    }
+    if ((mask & GCBackground) && values->background != gc_state.background) {
+        gc_state.background = values->background;
+        changed |= GCBackground;
+    }
+    if ((mask & GCFont) && values->font != gc_state.font) {
+        gc_state.font = values->font;
+        changed |= GCFont;
+    }
+    if (changed) {
+        draw_queue_flush();
+        XChangeGC(Xdisplay, TermWin.gc, changed, &gc_state);
+    }
 }
 
-int
-scr_multi2(void)
+/* Reverse the order of drawn rows from through to - 1. */
+static void
+drawn_rows_reverse(int from, int to)
 {
-    rend_t rend;
+    text_t *t;
+    rend_t *r;
+
+    for (to--; from < to; from++, to--) {
+        t = drawn_text[from];
+        drawn_text[from] = drawn_text[to];
+        drawn_text[to] = t;
+        r = drawn_rend[from];
+        drawn_rend[from] = drawn_rend[to];
+        drawn_rend[to] = r;
+    }
+}
 
-    if (screen.col == 0)
-        return 0;
-    rend = screen.rend[screen.row + TermWin.saveLines][screen.col - 1];
-    return ((rend & RS_multiMask) == RS_multi2);
+/* Rows <top> through <bot> of the screen have scrolled up by <count> rows (down if <count> is
+   negative) since they were drawn.  Copy the rows that are still visible to their new place
+   on <d>, and move drawn_text/drawn_rend along with them; the rows left behind are marked so
+   that scr_refresh() draws them from scratch. */
+static void
+scr_blit_scroll(Drawable d, int top, int bot, int count)
+{
+    int n = bot - top + 1, keep, i;
+
+    keep = n - ((count > 0) ? (count) : (-count));
+    D_SCREEN(("Scrolling rows %d-%d by %d with XCopyArea().\n", top, bot, count));
+    if (d == TermWin.vt) {
+        XSetGraphicsExposures(Xdisplay, TermWin.gc, True);
+        scroll_blits_pending++;
+    }
+    if (count > 0) {
+        XCopyArea(Xdisplay, d, d, TermWin.gc, Col2Pixel(0), Row2Pixel(top + count), Width2Pixel(TERM_WINDOW_GET_COLS()),
+                  Height2Pixel(keep), Col2Pixel(0), Row2Pixel(top));
+    } else {
+        XCopyArea(Xdisplay, d, d, TermWin.gc, Col2Pixel(0), Row2Pixel(top), Width2Pixel(TERM_WINDOW_GET_COLS()),
+                  Height2Pixel(keep), Col2Pixel(0), Row2Pixel(top - count));
+    }
+    if (d == TermWin.vt) {
+        XSetGraphicsExposures(Xdisplay, TermWin.gc, False);
+    }
+
+    /* Rotate the drawn rows the same way, in place:  up by count is reversing the first count
+       rows and the rest separately, then the whole lot. */
+    i = (count + n) % n;
+    drawn_rows_reverse(top, top + i);
+    drawn_rows_reverse(top + i, top + n);
+    drawn_rows_reverse(top, top + n);
+    for (i = ((count > 0) ? keep : 0); i < ((count > 0) ? n : -count); i++) {
+        memset(drawn_text[top + i], 0, TERM_WINDOW_GET_COLS());
+    }
 }
-#endif /* MULTI_CHARSET */
 
 /*
  * Refresh the screen
@@ -1643,6 +2632,8 @@ scr_refresh(int type)
         fprop,                  /* proportional font used                    */
         is_cursor,              /* cursor this position                      */
         rvid,                   /* reverse video this position               */
+        same_rend,              /* rendition of this row is as drawn         */
+        diverged,               /* drawn rendition no longer matches screen  */
         fore, back,             /* desired foreground/background             */
         wbyte,                  /* we're in multibyte                        */
         xpixel,                 /* x offset for start of drawing (font)      */
@@ -1650,6 +2641,8 @@ scr_refresh(int type)
     register int col, row,      /* column/row we're processing               */
      rend;                      /* rendition                                 */
     static int focus = -1;      /* screen in focus?                          */
+    static int cursor_row = -1, cursor_col = 0;  /* where the cursor was drawn */
+    int scan_all, col_start;    /* look at every row? where to start in one  */
     long gcmask;                /* Graphics Context mask                     */
     unsigned long ltmp;
     rend_t rt1, rt2,            /* tmp rend values                           */
@@ -1662,7 +2655,6 @@ scr_refresh(int type)
     register char *buffer = buf;
     Pixmap pmap = images[image_bg].current->pmap->pixmap;
     int (*draw_string) (), (*draw_image_string) ();
-    register int low_x = 99999, low_y = 99999, high_x = 0, high_y = 0;
     Drawable draw_buffer;
 
 #ifndef NO_BOLDFONT
@@ -1697,13 +2689,31 @@ scr_refresh(int type)
     }
 
     row_offset = TermWin.saveLines - TermWin.view_start;
+    scr_thaw_rows(row_offset, row_offset + TERM_WINDOW_GET_REPORTED_ROWS() - 1);
     fprop = TermWin.fprop;
 
+    if (scroll_count && !scroll_mixed && !refresh_all && !TermWin.view_start && SCROLL_BLIT_SAFE()
+        && (draw_buffer != TermWin.vt || !scroll_blits_pending)
+        && scroll_count < scroll_bot - scroll_top + 1 && -scroll_count < scroll_bot - scroll_top + 1) {
+        scr_blit_scroll(draw_buffer, scroll_top, scroll_bot, scroll_count);
+        UPDATE_BOX(Col2Pixel(0), Row2Pixel(scroll_top), Col2Pixel(TERM_WINDOW_GET_COLS()), Row2Pixel(scroll_bot + 1));
+    }
+    scroll_count = 0;
+    scroll_mixed = 0;
+
+    /* The dirty bits are by screen row, so they only describe the window when it isn't (and
+       wasn't) showing the scrollback. */
+    scan_all = (dirty_all || refresh_all || !dirty_rows || TermWin.view_start || dirty_view);
+
     gcvalue.foreground = PixColors[fgColor];
     gcvalue.background = PixColors[bgColor];
     wbyte = 0;
 
-    XSetFont(Xdisplay, TermWin.gc, TermWin.font->fid);
+    /* Others use TermWin.gc too, so start from a known state. */
+    gc_state.foreground = gcvalue.foreground;
+    gc_state.background = gcvalue.background;
+    gc_state.font = TermWin.font->fid;
+    XChangeGC(Xdisplay, TermWin.gc, GCForeground | GCBackground | GCFont, &gc_state);
 
 #if FIXME_BLOCK
     draw_string = XmbDrawString;
@@ -1718,21 +2728,26 @@ scr_refresh(int type)
 
     row = screen.row + TermWin.saveLines;
     col = screen.col;
+    DIRTY_ROW(cursor_row, cursor_col);
+    cursor_row = screen.row;
+    cursor_col = ((col > 0) ? (col - 1) : (0));
+    DIRTY_ROW(cursor_row, cursor_col);
     if (screen.flags & Screen_VisibleCursor) {
-        screen.rend[row][col] |= RS_Cursor;
+        row_runs_set(SCREEN_REND(row), col, SCREEN_REND(row)[col] | RS_Cursor);
 #ifdef MULTI_CHARSET
-        srp = &screen.rend[row][col];
+        srp = &SCREEN_REND(row)[col];
         if ((col < ncols - 1) && ((srp[0] & RS_multiMask) == RS_multi1)
             && ((srp[1] & RS_multiMask) == RS_multi2)) {
-            screen.rend[row][col + 1] |= RS_Cursor;
+            row_runs_set(SCREEN_REND(row), col + 1, SCREEN_REND(row)[col + 1] | RS_Cursor);
         } else if ((col > 0) && ((srp[0] & RS_multiMask) == RS_multi2)
                    && ((srp[-1] & RS_multiMask) == RS_multi1)) {
-            screen.rend[row][col - 1] |= RS_Cursor;
+            row_runs_set(SCREEN_REND(row), col - 1, SCREEN_REND(row)[col - 1] | RS_Cursor);
         }
 #endif
         if (focus != TermWin.focus) {
             focus = TermWin.focus;
             if ((i = screen.row - TermWin.view_start) >= 0) {
+                ROW_RUNS_FORGET(drawn_rend[i]);
                 drawn_rend[i][col] = RS_attrMask;
 #ifdef MULTI_CHARSET
                 if ((col < ncols - 1) && ((srp[1] & RS_multiMask) == RS_multi2)) {
@@ -1746,21 +2761,47 @@ scr_refresh(int type)
     }
 
     for (row = 0; row < nrows; row++) {
+        if (scan_all) {
+            col_start = 0;
+        } else if (ROW_IS_DIRTY(row)) {
+            col_start = dirty_col[row];
+#ifdef MULTI_CHARSET
+            /* back up onto the first half of a wide character */
+            if (col_start > 0)
+                col_start--;
+#endif
+        } else {
+            continue;
+        }
+        if (row < dirty_nrow) {
+            dirty_rows[row / DIRTY_BITS] &= ~(1UL << (row % DIRTY_BITS));
+            dirty_col[row] = ncols;
+        }
         scrrow = row + row_offset;
-        stp = screen.text[scrrow];
-        srp = screen.rend[scrrow];
+        stp = SCREEN_TEXT(scrrow);
+        srp = SCREEN_REND(scrrow);
         dtp = drawn_text[row];
         drp = drawn_rend[row];
 
-        for (col = 0; col < ncols; col++) {
+        same_rend = diverged = 0;
+        if (!refresh_all) {
+            /* if the rendition runs match what was drawn, only the text can differ */
+            if (ROW_RUNS(srp)->nruns == ROW_RUNS_UNKNOWN)
+                row_runs_scan(srp);
+            if ((same_rend = row_runs_equal(srp, drp)) && !memcmp(stp, dtp, ncols))
+                continue;
+        }
+        for (col = col_start; col < ncols; col++) {
             if (!refresh_all) {
                 /* compare new text with old - if exactly the same then continue */
                 rt1 = srp[col];
                 rt2 = drp[col];
                 if ((stp[col] == dtp[col])      /* must match characters to skip */
-                    &&((rt1 == rt2)     /* either rendition the same or  */
+                    &&(same_rend        /* either rendition the same or  */
+                       ||(rt1 == rt2)
                        ||((stp[col] == ' ')     /* space w/ no bg change */
-                          &&(GET_BGATTR(rt1) == GET_BGATTR(rt2))))) {
+                          &&(GET_BGATTR(rt1) == GET_BGATTR(rt2))
+                          && (diverged = 1)))) {
 #ifdef MULTI_CHARSET
                     /* if first byte is multibyte then compare second bytes */
                     if ((rt1 & RS_multiMask) != RS_multi1)
@@ -1795,7 +2836,7 @@ scr_refresh(int type)
                     && ((srp[col + 1]) & RS_multiMask) == RS_multi2) {
                     if (!wbyte) {
                         wbyte = 1;
-                        XSetFont(Xdisplay, TermWin.gc, TermWin.mfont->fid);
+                        scr_gc_font(TermWin.mfont->fid);
 # if FIXME_BLOCK
                         draw_string = XmbDrawString;
                         draw_image_string = XmbDrawImageString;
@@ -1832,13 +2873,15 @@ scr_refresh(int type)
                         /* XXX : maybe do the same thing for RS_multi2 */
                         /* corrupt character - you're outta there */
                         rend &= ~RS_multiMask;
+                        diverged = 1;
                         drp[col] = rend;        /* TODO check: may also want */
                         dtp[col] = ' '; /* to poke into stp/srp      */
                         buffer[0] = ' ';
+                        DIRTY_ROW(row, col);
                     }
                     if (wbyte) {
                         wbyte = 0;
-                        XSetFont(Xdisplay, TermWin.gc, TermWin.font->fid);
+                        scr_gc_font(TermWin.font->fid);
 # if FIXME_BLOCK
                         draw_string = XmbDrawString;
                         draw_image_string = XmbDrawImageString;
@@ -1941,16 +2984,14 @@ scr_refresh(int type)
                 }
             }
 #endif
-            if (gcmask) {
-                XChangeGC(Xdisplay, TermWin.gc, gcmask, &gcvalue);
-            }
+            scr_gc_change(GCForeground | GCBackground, &gcvalue);
 #ifndef NO_BOLDFONT
             if (!wbyte && MONO_BOLD(rend) && TermWin.boldFont) {
-                XSetFont(Xdisplay, TermWin.gc, TermWin.boldFont->fid);
+                scr_gc_font(TermWin.boldFont->fid);
                 bfont = 1;
             } else if (bfont) {
                 bfont = 0;
-                XSetFont(Xdisplay, TermWin.gc, TermWin.font->fid);
+                scr_gc_font(TermWin.font->fid);
             }
 #endif
 
@@ -1969,10 +3010,10 @@ scr_refresh(int type)
                 if (back != bgColor) {
                     SWAP_IT(gcvalue.foreground, gcvalue.background, ltmp);
                     gcmask |= (GCForeground | GCBackground);
-                    XChangeGC(Xdisplay, TermWin.gc, gcmask, &gcvalue);
+                    scr_gc_change(gcmask, &gcvalue);
                     XFillRectangle(Xdisplay, draw_buffer, TermWin.gc, xpixel, ypixel - ascent, Width2Pixel(1), Height2Pixel(1));
                     SWAP_IT(gcvalue.foreground, gcvalue.background, ltmp);
-                    XChangeGC(Xdisplay, TermWin.gc, gcmask, &gcvalue);
+                    scr_gc_change(gcmask, &gcvalue);
                 } else {
                     CLEAR_CHARS(xpixel, ypixel - ascent, 1);
                 }
@@ -2023,70 +3064,77 @@ scr_refresh(int type)
                                 for (ii = col - len + 1; ii <= col; ii++) {
                                     drawn_text[row + 1][ii] = 0;
                                 }
+                                DIRTY_ROW(row + 1, col - len + 1);
                             }
                         }
                         if (fshadow.shadow[SHADOW_TOP_LEFT]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_TOP_LEFT]);
+                            scr_gc_foreground(fshadow.color[SHADOW_TOP_LEFT]);
                             DRAW_STRING(draw_string, xpixel - 1, ypixel - 1, buffer, wlen);
                             if (col) {
                                 dtp[col - 1] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_TOP]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_TOP]);
+                            scr_gc_foreground(fshadow.color[SHADOW_TOP]);
                             DRAW_STRING(draw_string, xpixel, ypixel - 1, buffer, wlen);
                             if (col) {
                                 dtp[col] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_TOP_RIGHT]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_TOP_RIGHT]);
+                            scr_gc_foreground(fshadow.color[SHADOW_TOP_RIGHT]);
                             DRAW_STRING(draw_string, xpixel + 1, ypixel - 1, buffer, wlen);
                             if (col < ncols - 1) {
                                 dtp[col + 1] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_LEFT]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_LEFT]);
+                            scr_gc_foreground(fshadow.color[SHADOW_LEFT]);
                             DRAW_STRING(draw_string, xpixel - 1, ypixel, buffer, wlen);
                             if (col) {
                                 dtp[col - 1] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_RIGHT]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_RIGHT]);
+                            scr_gc_foreground(fshadow.color[SHADOW_RIGHT]);
                             DRAW_STRING(draw_string, xpixel + 1, ypixel, buffer, wlen);
                             if (col < ncols - 1) {
                                 dtp[col + 1] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_BOTTOM_LEFT]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_BOTTOM_LEFT]);
+                            scr_gc_foreground(fshadow.color[SHADOW_BOTTOM_LEFT]);
                             DRAW_STRING(draw_string, xpixel - 1, ypixel + 1, buffer, wlen);
                             if (col) {
                                 dtp[col - 1] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_BOTTOM]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_BOTTOM]);
+                            scr_gc_foreground(fshadow.color[SHADOW_BOTTOM]);
                             DRAW_STRING(draw_string, xpixel, ypixel + 1, buffer, wlen);
                             if (col) {
                                 dtp[col] = 0;
                             }
                         }
                         if (fshadow.shadow[SHADOW_BOTTOM_RIGHT]) {
-                            XSetForeground(Xdisplay, TermWin.gc, fshadow.color[SHADOW_BOTTOM_RIGHT]);
+                            scr_gc_foreground(fshadow.color[SHADOW_BOTTOM_RIGHT]);
                             DRAW_STRING(draw_string, xpixel + 1, ypixel + 1, buffer, wlen);
                             if (col < ncols - 1) {
                                 dtp[col + 1] = 0;
                             }
                         }
-                        XSetForeground(Xdisplay, TermWin.gc, tmp);
+                        scr_gc_foreground(tmp);
                         DRAW_STRING(draw_string, xpixel, ypixel, buffer, wlen);
                         UPDATE_BOX(xx, yy, xx + ww, yy + hh);
+                        /* the shadows knocked out cells that have already been passed */
+                        DIRTY_ROW(row, ((col > 0) ? (col - 1) : (0)));
                     } else {
                         CLEAR_CHARS(xpixel, ypixel - ascent, len);
-                        DRAW_STRING(draw_string, xpixel, ypixel, buffer, wlen);
+                        if (wbyte) {
+                            DRAW_STRING(draw_string, xpixel, ypixel, buffer, wlen);
+                        } else {
+                            draw_queue_text(draw_buffer, QUEUE_FONT(), xpixel, ypixel, buffer, wlen);
+                        }
                         UPDATE_BOX(xpixel, ypixel - ascent, xpixel + Width2Pixel(wlen), ypixel + Height2Pixel(1));
                     }
                 } else
@@ -2103,7 +3151,7 @@ scr_refresh(int type)
                         if (font->ascent < ascent || font->descent < descent) {
                             SWAP_IT(gcvalue.foreground, gcvalue.background, ltmp);
                             gcmask |= (GCForeground | GCBackground);
-                            XChangeGC(Xdisplay, TermWin.gc, gcmask, &gcvalue);
+                            scr_gc_change(gcmask, &gcvalue);
                             if (font->ascent < ascent) {
                                 XFillRectangle(Xdisplay, draw_buffer, TermWin.gc, xpixel, Row2Pixel(row), Width2Pixel(len),
                                                ascent - font->ascent);
@@ -2113,7 +3161,7 @@ scr_refresh(int type)
                                                Width2Pixel(len), descent - font->descent);
                             }
                             SWAP_IT(gcvalue.foreground, gcvalue.background, ltmp);
-                            XChangeGC(Xdisplay, TermWin.gc, gcmask, &gcvalue);
+                            scr_gc_change(gcmask, &gcvalue);
                         }
                     }
 #endif
@@ -2123,45 +3171,45 @@ scr_refresh(int type)
 
             /* do the convoluted bold overstrike */
             if (BITFIELD_IS_SET(vt_options, VT_OPTIONS_OVERSTRIKE_BOLD) && MONO_BOLD(rend)) {
-                DRAW_STRING(draw_string, xpixel + 1, ypixel, buffer, wlen);
+                if (wbyte) {
+                    DRAW_STRING(draw_string, xpixel + 1, ypixel, buffer, wlen);
+                } else {
+                    draw_queue_text(draw_buffer, QUEUE_FONT(), xpixel + 1, ypixel, buffer, wlen);
+                }
                 UPDATE_BOX(xpixel + 1, ypixel - ascent, xpixel + 1 + Width2Pixel(wlen), ypixel + Height2Pixel(1));
             }
 
             if (rend & RS_Uline) {
                 if (descent > 1) {
-                    XDrawLine(Xdisplay, draw_buffer, TermWin.gc, xpixel, ypixel + 1, xpixel + Width2Pixel(wlen) - 1, ypixel + 1);
+                    draw_queue_line(draw_buffer, xpixel, ypixel + 1, xpixel + Width2Pixel(wlen) - 1, ypixel + 1);
                     UPDATE_BOX(xpixel, ypixel + 1, xpixel + Width2Pixel(wlen) - 1, ypixel + 1);
                 } else {
-                    XDrawLine(Xdisplay, draw_buffer, TermWin.gc, xpixel, ypixel - 1, xpixel + Width2Pixel(wlen) - 1, ypixel - 1);
+                    draw_queue_line(draw_buffer, xpixel, ypixel - 1, xpixel + Width2Pixel(wlen) - 1, ypixel - 1);
                     UPDATE_BOX(xpixel, ypixel - 1, xpixel + Width2Pixel(wlen) - 1, ypixel - 1);
                 }
             }
             if (rend & RS_Overscore) {
                 if (ascent > 1) {
-                    XDrawLine(Xdisplay, draw_buffer, TermWin.gc, xpixel, ypixel - ascent, xpixel + Width2Pixel(wlen) - 1,
-                              ypixel - ascent);
+                    draw_queue_line(draw_buffer, xpixel, ypixel - ascent, xpixel + Width2Pixel(wlen) - 1, ypixel - ascent);
                     UPDATE_BOX(xpixel, ypixel + 1, xpixel + Width2Pixel(wlen) - 1, ypixel + 1);
                 } else {
-                    XDrawLine(Xdisplay, draw_buffer, TermWin.gc, xpixel, ypixel - 1, xpixel + Width2Pixel(wlen) - 1, ypixel - 1);
+                    draw_queue_line(draw_buffer, xpixel, ypixel - 1, xpixel + Width2Pixel(wlen) - 1, ypixel - 1);
                     UPDATE_BOX(xpixel, ypixel - 1, xpixel + Width2Pixel(wlen) - 1, ypixel - 1);
                 }
             }
             if (is_cursor == 1) {
 #ifndef NO_CURSORCOLOR
                 if (PixColors[cursorColor] != PixColors[bgColor]) {
-                    XSetForeground(Xdisplay, TermWin.gc, PixColors[cursorColor]);
+                    scr_gc_foreground(PixColors[cursorColor]);
                 }
 #endif
                 XDrawRectangle(Xdisplay, draw_buffer, TermWin.gc, xpixel, ypixel - ascent, Width2Pixel(1 + wbyte) - 1,
                                Height2Pixel(1) - 1);
-                UPDATE_BOX(xpixel, ypixel - ascent, Width2Pixel(1 + wbyte) - 1, Height2Pixel(1) - 1);
-                XSetForeground(Xdisplay, TermWin.gc, PixColors[fgColor]);
-            }
-            if (gcmask) {       /* restore normal colors */
-                gcvalue.foreground = PixColors[fgColor];
-                gcvalue.background = PixColors[bgColor];
-                XChangeGC(Xdisplay, TermWin.gc, gcmask, &gcvalue);
+                UPDATE_BOX(xpixel, ypixel - ascent, xpixel + Width2Pixel(1 + wbyte) - 1, ypixel - ascent + Height2Pixel(1) - 1);
             }
+            /* back to normal colors; the GC itself is only changed if the next run needs it */
+            gcvalue.foreground = PixColors[fgColor];
+            gcvalue.background = PixColors[bgColor];
             if (MONO_BOLD(lastrend)) {
                 if (col < ncols - 1) {
                     dtp[col + 1] = 0;
@@ -2170,24 +3218,35 @@ scr_refresh(int type)
                 }
             }
         }                       /* for (col = 0; col < TERM_WINDOW_GET_REPORTED_COLS(); col++) */
+        /* drawn_rend now matches screen.rend unless some cell was left alone */
+        if (!diverged && ROW_RUNS_KNOWN(srp))
+            *ROW_RUNS(drp) = *ROW_RUNS(srp);
+        else
+            ROW_RUNS_FORGET(drp);
     }                           /* for (row = 0; row < TERM_WINDOW_GET_REPORTED_ROWS(); row++) */
+    draw_queue_flush();
+    gcvalue.font = TermWin.font->fid;
+    scr_gc_change(GCForeground | GCBackground | GCFont, &gcvalue);
 
     row = screen.row + TermWin.saveLines;
     col = screen.col;
     if (screen.flags & Screen_VisibleCursor) {
-        screen.rend[row][col] &= ~RS_Cursor;
+        row_runs_set(SCREEN_REND(row), col, SCREEN_REND(row)[col] & ~RS_Cursor);
 #ifdef MULTI_CHARSET
         /* very low overhead so don't check properly, just wipe it all out */
         if (screen.col < ncols - 1)
-            screen.rend[row][col + 1] &= ~RS_Cursor;
+            row_runs_set(SCREEN_REND(row), col + 1, SCREEN_REND(row)[col + 1] & ~RS_Cursor);
         if (screen.col > 0)
-            screen.rend[row][col - 1] &= ~RS_Cursor;
+            row_runs_set(SCREEN_REND(row), col - 1, SCREEN_REND(row)[col - 1] & ~RS_Cursor);
 #endif
     }
     if (buffer_pixmap) {
-        D_SCREEN(("Update box dimensions:  from (%d, %d) to (%d, %d).  Dimensions %dx%d\n", low_x, low_y, high_x, high_y,
-                  high_x - low_x + 1, high_y - low_y + 1));
-        XClearArea(Xdisplay, TermWin.vt, low_x, low_y, high_x - low_x + 1, high_y - low_y + 1, False);
+        D_SCREEN(("Copying %d damaged area(s) to the window.\n", ndamage));
+        for (i = 0; i < ndamage; i++) {
+            XClearArea(Xdisplay, TermWin.vt, damage[i].x1, damage[i].y1, damage[i].x2 - damage[i].x1 + 1,
+                       damage[i].y2 - damage[i].y1 + 1, False);
+        }
+        ndamage = 0;
         if (fshadow.shadow[SHADOW_TOP_LEFT] || fshadow.shadow[SHADOW_LEFT] || fshadow.shadow[SHADOW_BOTTOM_LEFT]) {
             XCopyArea(Xdisplay, pmap, buffer_pixmap, TermWin.gc, TermWin.internalBorder - 1, 0, 1, TermWin_TotalHeight() - 1,
                       TermWin.internalBorder - 1, 0);
@@ -2225,7 +3284,12 @@ scr_refresh(int type)
     if (type == SLOW_REFRESH) {
         XSync(Xdisplay, False);
     }
+    if (cold_nthawed) {
+        cold_sweep();
+    }
     refresh_all = 0;
+    dirty_all = 0;
+    dirty_view = TermWin.view_start;
     D_SCREEN(("Exiting.\n"));
 
     PROF_DONE(scr_refresh);
@@ -2238,7 +3302,7 @@ scr_strmatch(unsigned long row, unsigned long col, const char *str)
     unsigned char c;
     const char *s;
 
-    for (c = screen.text[row][col], s = str; s; s++) {
+    for (c = SCREEN_TEXT(row)[col], s = str; s; s++) {
         if (c != *s) {
             return (0);
         }
@@ -2255,6 +3319,7 @@ scr_search_scrollback(char *str)
     static char *last_str = NULL;
     unsigned int *i;
     unsigned long row, lrow, col, rows, cols, len, k;
+    int packed, packed_next;
 
     if (!str) {
         if (!(str = last_str)) {
@@ -2266,16 +3331,20 @@ scr_search_scrollback(char *str)
     lrow = rows = TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines;
     cols = TERM_WINDOW_GET_REPORTED_COLS();
     len = strlen(str);
+    dirty_all = 1;
 
     D_SCREEN(("%d, %d\n", rows, cols));
     for (row = 0; row < rows; row++) {
-        if (screen.text[row]) {
-            c = screen.text[row];
+        packed = cold_peek(row);
+        packed_next = ((row < rows - 1) ? cold_peek(row + 1) : 0);
+        if (SCREEN_TEXT(row)) {
+            c = SCREEN_TEXT(row);
             for (s = strstr(c, str); s; s = strstr(s + 1, str)) {
                 unsigned long j;
 
                 col = (long) s - (long) c;
-                for (i = screen.rend[row] + col, j = 0; j < len; i++, j++) {
+                ROW_RUNS_FORGET(SCREEN_REND(row));
+                for (i = SCREEN_REND(row) + col, j = 0; j < len; i++, j++) {
                     if (*i & RS_RVid) {
                         *i &= ~RS_RVid;
                     } else {
@@ -2286,16 +3355,18 @@ scr_search_scrollback(char *str)
                     lrow = row;
                 }
             }
-            for (s = screen.text[row] + cols - len + 1, k = len - 1; k; s++, k--) {
+            for (s = SCREEN_TEXT(row) + cols - len + 1, k = len - 1; k; s++, k--) {
                 unsigned long j;
 
-                if ((row < rows - 1) && !strncasecmp(s, str, k) && screen.text[row + 1]
-                    && !strncasecmp(screen.text[row + 1], str + k, len - k)) {
+                if ((row < rows - 1) && !strncasecmp(s, str, k) && SCREEN_TEXT(row + 1)
+                    && !strncasecmp(SCREEN_TEXT(row + 1), str + k, len - k)) {
                     col = (long) s - (long) c;
-                    for (i = &(screen.rend[row][cols - k]), j = 0; j < k; i++, j++) {
+                    ROW_RUNS_FORGET(SCREEN_REND(row));
+                    ROW_RUNS_FORGET(SCREEN_REND(row + 1));
+                    for (i = &(SCREEN_REND(row)[cols - k]), j = 0; j < k; i++, j++) {
                         (*i & RS_RVid) ? (*i &= ~RS_RVid) : (*i |= RS_RVid);
                     }
-                    for (i = screen.rend[row + 1], j = 0, k = len - k; j < k; i++, j++) {
+                    for (i = SCREEN_REND(row + 1), j = 0, k = len - k; j < k; i++, j++) {
                         (*i & RS_RVid) ? (*i &= ~RS_RVid) : (*i |= RS_RVid);
                     }
                     if ((long) row <= TermWin.saveLines) {
@@ -2305,6 +3376,12 @@ scr_search_scrollback(char *str)
                 }
             }
         }
+        if (packed) {
+            cold_pack(row);
+        }
+        if (packed_next) {
+            cold_pack(row + 1);
+        }
     }
     if (last_str == str) {
         FREE(last_str);
@@ -2331,17 +3408,19 @@ scr_dump(void)
 
     D_SCREEN(("%d, %d\n", rows, cols));
     for (row = 0; row < rows; row++) {
+        int packed = cold_peek(row);
+
         fprintf(stderr, "%lu:  ", row);
-        if (screen.text[row]) {
-            for (col = 0, c = screen.text[row]; col < cols; c++, col++) {
+        if (SCREEN_TEXT(row)) {
+            for (col = 0, c = SCREEN_TEXT(row); col < cols; c++, col++) {
                 fprintf(stderr, "%02x ", *c);
             }
             fprintf(stderr, "\"");
-            for (col = 0, c = screen.text[row]; col < cols; c++, col++) {
+            for (col = 0, c = SCREEN_TEXT(row); col < cols; c++, col++) {
                 fprintf(stderr, "%c", ((isprint(*c)) ? (*c) : '.'));
             }
             fprintf(stderr, "\"");
-            for (col = 0, i = screen.rend[row]; col < cols; i++, col++) {
+            for (col = 0, i = SCREEN_REND(row); col < cols; i++, col++) {
                 fprintf(stderr, " %08x", *i);
             }
         } else {
@@ -2349,6 +3428,9 @@ scr_dump(void)
         }
         fprintf(stderr, "\n");
         fflush(stderr);
+        if (packed) {
+            cold_pack(row);
+        }
     }
 }
 
@@ -2387,13 +3469,18 @@ scr_dump_to_file(const char *fname)
     }
     buff = MALLOC(cols + 1);
     for (row = 0; row < rows; row++) {
-        if (screen.text[row]) {
-            for (src = screen.text[row], dest = buff, col = 0; col < cols; col++)
+        int packed = cold_peek(row);
+
+        if (SCREEN_TEXT(row)) {
+            for (src = SCREEN_TEXT(row), dest = buff, col = 0; col < cols; col++)
                 *dest++ = *src++;
             *dest++ = '\n';
             *dest = 0;
             write(outfd, buff, dest - buff);
         }
+        if (packed) {
+            cold_pack(row);
+        }
     }
     close(outfd);
     FREE(buff);
@@ -2454,30 +3541,207 @@ selection_check(void)
     }
 }
 
-/* Write the selection out to the tty. */
+/* Look up the text of buffer row <row> without thawing it:  *avail gets how many columns
+   of it are stored (the rest are blanks), and the return value its line length/WRAP_CHAR. */
+static int
+selection_row_text(int row, text_t **text, int *avail)
+{
+    int ncol = row_arena.ncol, slot = SCREEN_SLOT(row);
+    cold_row_t *c;
+
+    if (screen.text[slot]) {
+        *text = screen.text[slot];
+        *avail = ncol;
+        return (*text)[ncol];
+    } else if (cold_rows && (c = cold_rows[slot])) {
+        *text = COLD_ROW_TEXT(c);
+        *avail = MIN(c->len, ncol);
+        return ((c->ncol == ncol) ? (c->eol) : MIN(c->eol, ncol));
+    }
+    *text = NULL;
+    *avail = 0;
+    return 0;
+}
+
+/* Render the screen text from <beg> through <end> the way a selection has always been
+   copied:  wrapped lines joined, trailing blanks dropped unless asked for, and a newline
+   after each line that ends.  With no <dest>, just count.  Stops after <max> bytes and
+   returns how many it produced; <next>, if given, is where to pick up from for the rest. */
+static size_t
+selection_render(row_col_t beg, row_col_t end, unsigned char *dest, size_t max, row_col_t *next)
+{
+    int row, end_row, col, end_col, eol, avail, ncol = row_arena.ncol;
+    unsigned char nl, trim;
+    text_t *t;
+    size_t len = 0, n;
+
+    col = MAX(beg.col, 0);
+    end_row = end.row + TermWin.saveLines;
+    for (row = beg.row + TermWin.saveLines; row <= end_row && len < max; row++, col = 0) {
+        eol = selection_row_text(row, &t, &avail);
+        if (row < end_row) {
+            nl = (eol != WRAP_CHAR);
+            end_col = (nl ? eol : ncol);
+        } else {
+            nl = (eol != WRAP_CHAR && end.col > eol);
+            end_col = (nl ? eol : end.col + 1);
+            UPPER_BOUND(end_col, ncol);
+        }
+        trim = (nl || row == end_row) && !(BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_SELECT_TRAILING_SPACES));
+        if (trim) {
+            UPPER_BOUND(end_col, avail);
+            for (; end_col > col && (t[end_col - 1] == ' ' || t[end_col - 1] == '\t'); end_col--);
+        }
+        if (end_col > col) {
+            n = MIN((size_t) (end_col - col), max - len);
+            if (dest) {
+                if (col < avail) {
+                    memcpy(dest + len, t + col, MIN(n, (size_t) (avail - col)));
+                }
+                if (col + (int) n > avail) {
+                    memset(dest + len + MAX(avail - col, 0), ' ', col + n - MAX(avail, col));
+                }
+            }
+            len += n;
+            col += n;
+        }
+        if (col < end_col || (nl && len == max)) {
+            /* Ran out of room partway through this row. */
+            break;
+        }
+        if (nl) {
+            if (dest) {
+                dest[len] = '\n';
+            }
+            len++;
+        }
+    }
+    if (next) {
+        next->row = row - TermWin.saveLines;
+        next->col = col;
+    }
+    return len;
+}
+
+/* Get the selected text, rendering it from the screen if it's still lazy.  Hand it back
+   with selection_text_done() when finished with it. */
+static unsigned char *
+selection_text(size_t *len)
+{
+    unsigned char *text;
+
+    if (!selection.lazy) {
+        *len = selection.len;
+        return selection.text;
+    }
+    *len = selection_render(selection.text_beg, selection.text_end, NULL, (size_t) -1, NULL);
+    text = (unsigned char *) MALLOC(*len + 1);
+    selection_render(selection.text_beg, selection.text_end, text, *len, NULL);
+    text[*len] = 0;
+    D_SELECT(("Rendered %lu bytes of selection from rows %d through %d\n", (unsigned long) *len,
+              selection.text_beg.row, selection.text_end.row));
+    return text;
+}
+
+static void
+selection_text_done(unsigned char *text)
+{
+    if (text && text != selection.text) {
+        FREE(text);
+    }
+}
+
+/* The rows a lazy selection lives in are about to change, so copy its text out now. */
+static void
+selection_save(void)
+{
+    size_t len;
+
+    if (!selection.lazy) {
+        return;
+    }
+    selection_send_detach();
+    selection.text = selection_text(&len);
+    selection.len = len;
+    selection.lazy = 0;
+}
+
+/* Whether a bracketed paste has been opened and not yet closed. */
+static unsigned char paste_open = 0;
+
+/* Close the paste in progress, if the application asked for bracketed paste
+   (DEC private mode 2004) and one was opened.  */
+void
+selection_write_end(void)
+{
+    if (paste_open) {
+        tt_write("\033[201~", 6);
+        paste_open = 0;
+    }
+}
+
+/* Write the selection out to the tty.  The newlines become carriage returns as
+   the data is queued, and an incremental transfer is framed as one paste.  Inside
+   the brackets every ESC is dropped, so the text can't end the paste early with its
+   own ESC [ 201 ~ and have the rest taken as typed; since no ESC gets through at
+   all, one split across two INCR chunks is caught too. */
 void
 selection_write(unsigned char *data, size_t len)
 {
-    size_t num;
-    unsigned char *p, *cr = "\r";
+    unsigned char *esc;
 
     D_SELECT(("Writing %lu characters of selection data to tty.\n", len));
     D_SELECT(("\n%s\n\n", safe_print_string((char *) data, len)));
-    for (p = data, num = 0; len--; p++) {
-        /* Write out each line, replacing newlines with carriage returns. */
-        if (*p != '\n') {
-            num++;
-        } else {
-            tt_write(data, num);
-            tt_write(cr, 1);
-            data += num + 1;
-            num = 0;
+    if (!paste_open && (PrivateModes & PrivMode_BracketPaste)) {
+        tt_write("\033[200~", 6);
+        paste_open = 1;
+    }
+    if (paste_open) {
+        while ((esc = (unsigned char *) memchr(data, '\033', len)) != NULL) {
+            tt_paste(data, esc - data);
+            len -= esc - data + 1;
+            data = esc + 1;
         }
     }
-    /* If there's anything left, write it out too. */
-    if (num) {
-        tt_write(data, num);
+    tt_paste(data, len);
+}
+
+/* An incoming incremental (INCR) selection transfer.  The owner writes each chunk into our
+   property and waits for us to delete it; we hold off deleting while the tty is still
+   working through a backlog, so a huge paste never piles up in memory. */
+static struct {
+    Window win;
+    Atom prop;
+    unsigned char active, stalled;
+    timerhdl_t timer;           /* goes off if no chunk turns up for INCR_TIMEOUT seconds */
+} incr_recv = { None, None, 0, 0, NULL };
+
+/* The paste is over, one way or another. */
+static void
+selection_fetch_done(void)
+{
+    incr_recv.active = incr_recv.stalled = 0;
+    if (incr_recv.timer) {
+        timer_del(incr_recv.timer);
+        incr_recv.timer = NULL;
+    }
+    if (TermWin.mask & PropertyChangeMask) {
+        TermWin.mask &= ~(PropertyChangeMask);
+        XSelectInput(Xdisplay, TermWin.vt, TermWin.mask);
     }
+    selection_write_end();
+}
+
+/* The owner of an incremental selection has stopped sending (or we held off so long that
+   it gave up on us), so close the paste rather than leave it open forever. */
+static unsigned char
+selection_fetch_timeout(void *data)
+{
+    USE_VAR(data);
+    D_SELECT(("No incremental selection data for %d seconds; giving up.\n", INCR_TIMEOUT));
+    incr_recv.timer = NULL;     /* timer_check() deletes it when we return 0 */
+    selection_fetch_done();
+    return 0;
 }
 
 /* Fetch the selection from the specified property and write it to the tty. */
@@ -2492,6 +3756,7 @@ selection_fetch(Window win, unsigned prop, int delete)
 
     D_SELECT(("Fetching selection in property %d from window 0x%08x\n", (int) prop, (int) win));
     if (prop == None) {
+        selection_fetch_done();
         return;
     }
     for (nread = 0, bytes_after = 1; bytes_after > 0;) {
@@ -2503,6 +3768,7 @@ selection_fetch(Window win, unsigned prop, int delete)
             if (data) {
                 XFree(data);
             }
+            selection_fetch_done();
             return;
         }
         nread += nitems;
@@ -2511,8 +3777,8 @@ selection_fetch(Window win, unsigned prop, int delete)
 
         if (nitems == 0) {
             D_SELECT(("Retrieval of incremental selection complete.\n"));
-            TermWin.mask &= ~(PropertyChangeMask);
-            XSelectInput(Xdisplay, TermWin.vt, TermWin.mask);
+            XFree(data);
+            selection_fetch_done();
             return;
         }
         if (actual_type == XA_STRING) {
@@ -2521,8 +3787,19 @@ selection_fetch(Window win, unsigned prop, int delete)
         } else if (actual_type == props[PROP_SELECTION_INCR]) {
             D_SELECT(("Incremental selection transfer initiated.  Length is at least %u bytes.\n",
                       (unsigned) *((unsigned *) data)));
-            TermWin.mask |= PropertyChangeMask;
-            XSelectInput(Xdisplay, TermWin.vt, TermWin.mask);
+            incr_recv.win = win;
+            incr_recv.prop = prop;
+            incr_recv.active = 1;
+            incr_recv.stalled = 0;
+            if (incr_recv.timer) {
+                timer_change_delay(incr_recv.timer, INCR_TIMEOUT * 1000);
+            } else {
+                incr_recv.timer = timer_add(INCR_TIMEOUT * 1000, selection_fetch_timeout, NULL);
+            }
+            if (!(TermWin.mask & PropertyChangeMask)) {
+                TermWin.mask |= PropertyChangeMask;
+                XSelectInput(Xdisplay, TermWin.vt, TermWin.mask);
+            }
         } else {
             int size, i;
             XTextProperty xtextp;
@@ -2550,6 +3827,52 @@ selection_fetch(Window win, unsigned prop, int delete)
             XFree(data);
         }
     }
+    if (!incr_recv.active) {
+        selection_fetch_done();
+    }
+}
+
+/* The owner of an incremental selection has put the next chunk in our property. */
+void
+selection_fetch_incr(Window win, unsigned prop)
+{
+    if (!incr_recv.active || incr_recv.stalled || win != incr_recv.win || prop != incr_recv.prop) {
+        return;
+    }
+    D_SELECT(("Fetching next part of incremental selection.\n"));
+    timer_change_delay(incr_recv.timer, INCR_TIMEOUT * 1000);
+    selection_fetch(win, prop, False);
+
+    /* Deleting the property asks for the next chunk (or acknowledges the last one). */
+    if (incr_recv.active && tt_pending() >= PASTE_BACKLOG) {
+        D_SELECT(("%lu bytes of paste still queued; holding off the next chunk.\n", tt_pending()));
+        incr_recv.stalled = 1;
+    } else {
+        XDeleteProperty(Xdisplay, win, prop);
+    }
+}
+
+/* Ask for the next chunk of a held-off incremental selection once the tty has caught up. */
+void
+selection_fetch_resume(void)
+{
+    if (incr_recv.stalled && tt_pending() < PASTE_BACKLOG) {
+        D_SELECT(("Paste backlog down to %lu bytes; resuming incremental selection.\n", tt_pending()));
+        incr_recv.stalled = 0;
+        XDeleteProperty(Xdisplay, incr_recv.win, incr_recv.prop);
+    }
+}
+
+/* Take ownership of the specified selection. */
+static void
+selection_own(Atom sel)
+{
+    D_SELECT(("Changing ownership of selection %d to my window 0x%08x\n", (int) sel, (int) TermWin.vt));
+    XSetSelectionOwner(Xdisplay, sel, TermWin.vt, CurrentTime);
+    if (XGetSelectionOwner(Xdisplay, sel) != TermWin.vt) {
+        libast_print_error("Can't take ownership of selection\n");
+    }
+    XFlush(Xdisplay);
 }
 
 /* Copy a specific string of a given length to the buffer specified. */
@@ -2561,12 +3884,7 @@ selection_copy_string(Atom sel, char *str, size_t len)
         return;
     }
     if (IS_SELECTION(sel)) {
-        D_SELECT(("Changing ownership of selection %d to my window 0x%08x\n", (int) sel, (int) TermWin.vt));
-        XSetSelectionOwner(Xdisplay, sel, TermWin.vt, CurrentTime);
-        if (XGetSelectionOwner(Xdisplay, sel) != TermWin.vt) {
-            libast_print_error("Can't take ownership of selection\n");
-        }
-        XFlush(Xdisplay);
+        selection_own(sel);
     } else {
         D_SELECT(("Copying selection to cut buffer %d\n", (int) sel));
         XChangeProperty(Xdisplay, Xroot, sel, XA_STRING, 8, PropModeReplace, str, len);
@@ -2577,7 +3895,17 @@ selection_copy_string(Atom sel, char *str, size_t len)
 void
 selection_copy(Atom sel)
 {
-    selection_copy_string(sel, selection.text, selection.len);
+    unsigned char *text;
+    size_t len;
+
+    if (selection.lazy && IS_SELECTION(sel)) {
+        /* Nobody needs the text until they ask us for it. */
+        selection_own(sel);
+        return;
+    }
+    text = selection_text(&len);
+    selection_copy_string(sel, (char *) text, len);
+    selection_text_done(text);
 }
 
 /* Paste the specified selection from the specified buffer. */
@@ -2585,15 +3913,31 @@ void
 selection_paste(Atom sel)
 {
     D_SELECT(("Attempting to paste selection %d.\n", (int) sel));
-    if (selection.text) {
+    if (incr_recv.active || paste_open) {
+        /* Whatever's left of an earlier paste isn't coming now. */
+        selection_fetch_done();
+    }
+    if (selection.text || selection.lazy) {
+        unsigned char *text;
+        size_t len;
+
         /* If we have a selection of our own, paste it. */
-        D_SELECT(("Pasting my current selection of length %lu\n", selection.len));
-        selection_write(selection.text, selection.len);
+        text = selection_text(&len);
+        D_SELECT(("Pasting my current selection of length %lu\n", (unsigned long) len));
+        selection_write(text, len);
+        selection_write_end();
+        selection_text_done(text);
     } else if (IS_SELECTION(sel)) {
         /* Request the current selection be converted to the appropriate
            form (usually XA_STRING) and save it for us in the VT_SELECTION
            property.  We'll then get a SelectionNotify. */
         D_SELECT(("Requesting current selection (%d) -> VT_SELECTION (%d)\n", sel, props[PROP_SELECTION_DEST]));
+        /* Watch our property from the start, so the first chunk of an incremental
+           transfer can't slip past between reading the INCR and deleting it. */
+        if (!(TermWin.mask & PropertyChangeMask)) {
+            TermWin.mask |= PropertyChangeMask;
+            XSelectInput(Xdisplay, TermWin.vt, TermWin.mask);
+        }
 #if defined(MULTI_CHARSET)
         if (encoding_method != LATIN1) {
             XConvertSelection(Xdisplay, sel, props[PROP_COMPOUND_TEXT], props[PROP_SELECTION_DEST], TermWin.vt, CurrentTime);
@@ -2620,13 +3964,15 @@ selection_reset(void)
     lrow = TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines;
     lcol = TERM_WINDOW_GET_REPORTED_COLS();
     selection.op = SELECTION_CLEAR;
+    dirty_all = 1;
 
     i = (current_screen == PRIMARY) ? 0 : TermWin.saveLines;
     for (; i < lrow; i++) {
-        if (screen.text[i]) {
+        if (SCREEN_TEXT(i)) {
             for (j = 0; j < lcol; j++) {
-                screen.rend[i][j] &= ~RS_Select;
+                SCREEN_REND(i)[j] &= ~RS_Select;
             }
+            ROW_RUNS_FORGET(SCREEN_REND(i));
         }
     }
 }
@@ -2640,7 +3986,11 @@ selection_clear(void)
     if (selection.text) {
         FREE(selection.text);
     }
+    if (selection.lazy) {
+        selection_send_detach();
+    }
     selection.len = 0;
+    selection.lazy = 0;
     selection_reset();
 }
 
@@ -2666,26 +4016,31 @@ selection_setclr(int set, int startr, int startc, int endr, int endc)
 
     startr += TermWin.saveLines;
     endr += TermWin.saveLines;
+    scr_thaw_rows(startr, endr);
 
+    for (row = startr; row <= endr; row++) {
+        ROW_RUNS_FORGET(SCREEN_REND(row));
+    }
+    scr_dirty_rows(startr, endr);
     col = startc;
     if (set) {
         for (row = startr; row < endr; row++) {
-            rend = &(screen.rend[row][col]);
+            rend = &(SCREEN_REND(row)[col]);
             for (; col <= last_col; col++, rend++)
                 *rend |= RS_Select;
             col = 0;
         }
-        rend = &(screen.rend[row][col]);
+        rend = &(SCREEN_REND(row)[col]);
         for (; col <= endc; col++, rend++)
             *rend |= RS_Select;
     } else {
         for (row = startr; row < endr; row++) {
-            rend = &(screen.rend[row][col]);
+            rend = &(SCREEN_REND(row)[col]);
             for (; col <= last_col; col++, rend++)
                 *rend &= ~RS_Select;
             col = 0;
         }
-        rend = &(screen.rend[row][col]);
+        rend = &(SCREEN_REND(row)[col]);
         for (; col <= endc; col++, rend++)
             *rend &= ~RS_Select;
     }
@@ -2723,7 +4078,8 @@ selection_start_colrow(int col, int row)
     BOUND(row, 0, TERM_WINDOW_GET_REPORTED_ROWS() - 1);
 
     row -= TermWin.view_start;
-    end_col = screen.text[row + TermWin.saveLines][TERM_WINDOW_GET_REPORTED_COLS()];
+    scr_thaw_rows(row + TermWin.saveLines, row + TermWin.saveLines);
+    end_col = SCREEN_TEXT(row + TermWin.saveLines)[TERM_WINDOW_GET_REPORTED_COLS()];
     if (end_col != WRAP_CHAR && col > end_col)
         col = TERM_WINDOW_GET_REPORTED_COLS();
     selection.mark.col = col;
@@ -2737,11 +4093,6 @@ selection_start_colrow(int col, int row)
 void
 selection_make(Time tm)
 {
-    int i, col, end_col, row, end_row;
-    text_t *new_selection_text;
-    char *str;
-    text_t *t;
-
     D_SELECT(("selection.op=%d, selection.clicks=%d\n", selection.op, selection.clicks));
     switch (selection.op) {
         case SELECTION_CONT:
@@ -2766,63 +4117,27 @@ selection_make(Time tm)
         selection_reset();
         return;
     }
-    i = (selection.end.row - selection.beg.row + 1) * (TERM_WINDOW_GET_REPORTED_COLS() + 1) + 1;
-    str = MALLOC(i * sizeof(char));
-    new_selection_text = (unsigned char *) str;
-
-    col = MAX(selection.beg.col, 0);
-    row = selection.beg.row + TermWin.saveLines;
-    end_row = selection.end.row + TermWin.saveLines;
-/*
- * A: rows before end row
- */
-    for (; row < end_row; row++) {
-        t = &(screen.text[row][col]);
-        if ((end_col = screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()]) == WRAP_CHAR)
-            end_col = TERM_WINDOW_GET_REPORTED_COLS();
-        for (; col < end_col; col++)
-            *str++ = *t++;
-        col = 0;
-        if (screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()] != WRAP_CHAR) {
-            if (!(BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_SELECT_TRAILING_SPACES))) {
-                for (str--; *str == ' ' || *str == '\t'; str--);
-                str++;
-            }
-            *str++ = '\n';
-        }
-    }
-/*
- * B: end row
- */
-    t = &(screen.text[row][col]);
-    end_col = screen.text[row][TERM_WINDOW_GET_REPORTED_COLS()];
-    if (end_col == WRAP_CHAR || selection.end.col <= end_col) {
-        i = 0;
-        end_col = selection.end.col + 1;
-    } else
-        i = 1;
-    UPPER_BOUND(end_col, TERM_WINDOW_GET_REPORTED_COLS());
-    for (; col < end_col; col++)
-        *str++ = *t++;
-    if (!(BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_SELECT_TRAILING_SPACES))) {
-        for (str--; *str == ' ' || *str == '\t'; str--);
-        str++;
-    }
-    if (i)
-        *str++ = '\n';
-    *str = '\0';
-    if ((i = strlen((char *) new_selection_text)) == 0) {
-        FREE(new_selection_text);
+    if (!selection_render(selection.beg, selection.end, NULL, 1, NULL)) {
+        /* Nothing but blanks; keep whatever was selected before. */
         return;
     }
-    selection.len = i;
-    if (selection.text)
+
+    /* Don't copy anything yet.  The text stays where it is until someone asks for it
+       or the rows it's in are about to change. */
+    if (selection.text) {
         FREE(selection.text);
-    selection.text = new_selection_text;
+    }
+    if (selection.lazy) {
+        selection_send_detach();
+    }
+    selection.len = 0;
+    selection.text_beg = selection.beg;
+    selection.text_end = selection.end;
+    selection.lazy = 1;
     selection.screen = current_screen;
 
     selection_copy(XA_PRIMARY);
-    D_SELECT(("selection.len=%d\n", selection.len));
+    D_SELECT(("Selected rows %d through %d\n", selection.text_beg.row, selection.text_end.row));
     return;
     tm = 0;
 }
@@ -2898,26 +4213,27 @@ selection_delimit_word(int col, int row, row_col_t *beg, row_col_t *end)
     beg_row = end_row = row;
 
     row_offset = TermWin.saveLines;
+    scr_thaw_rows(row + row_offset, row + row_offset);
 
 /* A: find the beginning of the word */
 
-    if (!screen.text[beg_row + row_offset] || !screen.rend[beg_row + row_offset])
+    if (!SCREEN_TEXT(beg_row + row_offset) || !SCREEN_REND(beg_row + row_offset))
         return;
-    if (!screen.text[end_row + row_offset] || !screen.rend[end_row + row_offset])
+    if (!SCREEN_TEXT(end_row + row_offset) || !SCREEN_REND(end_row + row_offset))
         return;
 #if 0
-    if (!screen.text[beg_row + row_offset - 1] || !screen.rend[beg_row + row_offset - 1])
+    if (!SCREEN_TEXT(beg_row + row_offset - 1) || !SCREEN_REND(beg_row + row_offset - 1))
         return;
-    if (!screen.text[end_row + row_offset + 1] || !screen.rend[end_row + row_offset + 1])
+    if (!SCREEN_TEXT(end_row + row_offset + 1) || !SCREEN_REND(end_row + row_offset + 1))
         return;
 #endif
 
-    stp1 = stp = &(screen.text[beg_row + row_offset][beg_col]);
+    stp1 = stp = &(SCREEN_TEXT(beg_row + row_offset)[beg_col]);
     w1 = DELIMIT_TEXT(*stp);
     if (w1 == 2)
         w1 = 0;
 #ifdef MULTI_CHARSET
-    srp = &(screen.rend[beg_row + row_offset][beg_col]);
+    srp = &(SCREEN_REND(beg_row + row_offset)[beg_col]);
     w2 = DELIMIT_REND(*srp);
 #endif
 
@@ -2937,7 +4253,7 @@ selection_delimit_word(int col, int row, row_col_t *beg, row_col_t *end)
                 if (DELIMIT_TEXT(*stp)) /* space or tab or cutchar */
                     break;
 #ifdef MULTI_CHARSET
-                srp = &(screen.rend[beg_row + row_offset][beg_col - 1]);
+                srp = &(SCREEN_REND(beg_row + row_offset)[beg_col - 1]);
 #endif
                 for (; --beg_col > 0;) {
                     t = *--stp;
@@ -2952,11 +4268,12 @@ selection_delimit_word(int col, int row, row_col_t *beg, row_col_t *end)
             }
         }
         if (beg_col == 0 && (beg_row > -TermWin.nscrolled)) {
-            stp = &(screen.text[beg_row + row_offset - 1][last_col + 1]);
+            scr_thaw_rows(beg_row + row_offset - 1, beg_row + row_offset - 1);
+            stp = &(SCREEN_TEXT(beg_row + row_offset - 1)[last_col + 1]);
             if (*stp == WRAP_CHAR) {
                 t = *(stp - 1);
 #ifdef MULTI_CHARSET
-                srp = &(screen.rend[beg_row + row_offset - 1][last_col + 1]);
+                srp = &(SCREEN_REND(beg_row + row_offset - 1)[last_col + 1]);
                 r = *(srp - 1);
                 if (DELIMIT_TEXT(t) == w1 && (!w1 || *stp == t || !(BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_XTERM_SELECT)))
                     && DELIMIT_REND(r) == w2) {
@@ -2979,11 +4296,11 @@ selection_delimit_word(int col, int row, row_col_t *beg, row_col_t *end)
 # ifdef OPTIMIZE_HACKS
     stp = stp1;
 # else
-    stp1 = stp = &(screen.text[end_row + row_offset][end_col]);
+    stp1 = stp = &(SCREEN_TEXT(end_row + row_offset)[end_col]);
 # endif
 
 #ifdef MULTI_CHARSET
-    srp = &(screen.rend[end_row + row_offset][end_col]);
+    srp = &(SCREEN_REND(end_row + row_offset)[end_col]);
 #endif
     for (;;) {
         for (; end_col < last_col; end_col++) {
@@ -3001,7 +4318,7 @@ selection_delimit_word(int col, int row, row_col_t *beg, row_col_t *end)
                 if (DELIMIT_TEXT(*stp)) /* space or tab or cutchar */
                     break;
 #ifdef MULTI_CHARSET
-                srp = &(screen.rend[end_row + row_offset][end_col + 1]);
+                srp = &(SCREEN_REND(end_row + row_offset)[end_col + 1]);
 #endif
                 for (; ++end_col < last_col;) {
                     t = *++stp;
@@ -3017,9 +4334,10 @@ selection_delimit_word(int col, int row, row_col_t *beg, row_col_t *end)
         }
         if (end_col == last_col && (end_row < (TERM_WINDOW_GET_REPORTED_ROWS() - 1))) {
             if (*++stp == WRAP_CHAR) {
-                stp = screen.text[end_row + row_offset + 1];
+                scr_thaw_rows(end_row + row_offset + 1, end_row + row_offset + 1);
+                stp = SCREEN_TEXT(end_row + row_offset + 1);
 #ifdef MULTI_CHARSET
-                srp = screen.rend[end_row + row_offset + 1];
+                srp = SCREEN_REND(end_row + row_offset + 1);
                 if (DELIMIT_TEXT(*stp) == w1
                     && (!w1 || *stp1 == *stp || !(BITFIELD_IS_SET(eterm_options, ETERM_OPTIONS_XTERM_SELECT)))
                     && DELIMIT_REND(*srp) == w2) {
@@ -3134,6 +4452,7 @@ selection_extend_colrow(int col, int row, int flag, int cont)
         selection.op = SELECTION_CONT;
 
     row -= TermWin.view_start;  /* adjust for scroll */
+    scr_thaw_rows(row + TermWin.saveLines, row + TermWin.saveLines);
 
     if (flag) {
         if (row < selection.beg.row || (row == selection.beg.row && col < selection.beg.col))
@@ -3154,7 +4473,7 @@ selection_extend_colrow(int col, int row, int flag, int cont)
             if (closeto == LEFT) {
                 selection.beg.row = row;
                 selection.beg.col = col;
-                end_col = screen.text[row + TermWin.saveLines][TERM_WINDOW_GET_REPORTED_COLS()];
+                end_col = SCREEN_TEXT(row + TermWin.saveLines)[TERM_WINDOW_GET_REPORTED_COLS()];
                 if (end_col != WRAP_CHAR && selection.beg.col > end_col) {
                     if (selection.beg.row < selection.end.row) {
                         selection.beg.col = -1;
@@ -3167,7 +4486,7 @@ selection_extend_colrow(int col, int row, int flag, int cont)
             } else {
                 selection.end.row = row;
                 selection.end.col = col - 1;
-                end_col = screen.text[row + TermWin.saveLines][TERM_WINDOW_GET_REPORTED_COLS()];
+                end_col = SCREEN_TEXT(row + TermWin.saveLines)[TERM_WINDOW_GET_REPORTED_COLS()];
                 if (end_col != WRAP_CHAR && selection.end.col >= end_col)
                     selection.end.col = TERM_WINDOW_GET_REPORTED_COLS() - 1;
             }
@@ -3179,7 +4498,7 @@ selection_extend_colrow(int col, int row, int flag, int cont)
             selection.end.row = selection.mark.row;
             selection.end.col = selection.mark.col - 1;
             if (selection.end.col >= 0) {
-                end_col = screen.text[row + TermWin.saveLines][TERM_WINDOW_GET_REPORTED_COLS()];
+                end_col = SCREEN_TEXT(row + TermWin.saveLines)[TERM_WINDOW_GET_REPORTED_COLS()];
                 if (end_col != WRAP_CHAR && selection.beg.col > end_col) {
                     if (selection.beg.row < selection.end.row) {
                         selection.beg.col = -1;
@@ -3197,7 +4516,7 @@ selection_extend_colrow(int col, int row, int flag, int cont)
             selection.end.row = row;
             selection.end.col = col - 1;
             if (old_col >= 0) {
-                end_col = screen.text[row + TermWin.saveLines][TERM_WINDOW_GET_REPORTED_COLS()];
+                end_col = SCREEN_TEXT(row + TermWin.saveLines)[TERM_WINDOW_GET_REPORTED_COLS()];
                 if (end_col != WRAP_CHAR && selection.end.col >= end_col)
                     selection.end.col = TERM_WINDOW_GET_REPORTED_COLS() - 1;
             }
@@ -3205,14 +4524,14 @@ selection_extend_colrow(int col, int row, int flag, int cont)
 #ifdef MULTI_CHARSET
         if ((selection.beg.col > 0) && (selection.beg.col < TERM_WINDOW_GET_REPORTED_COLS())) {
             r = selection.beg.row + TermWin.saveLines;
-            if (((screen.rend[r][selection.beg.col] & RS_multiMask) == RS_multi2)
-                && ((screen.rend[r][selection.beg.col - 1] & RS_multiMask) == RS_multi1))
+            if (((SCREEN_REND(r)[selection.beg.col] & RS_multiMask) == RS_multi2)
+                && ((SCREEN_REND(r)[selection.beg.col - 1] & RS_multiMask) == RS_multi1))
                 selection.beg.col--;
         }
         if ((selection.end.col > 0) && (selection.end.col < (TERM_WINDOW_GET_REPORTED_COLS() - 1))) {
             r = selection.end.row + TermWin.saveLines;
-            if (((screen.rend[r][selection.end.col] & RS_multiMask) == RS_multi1)
-                && ((screen.rend[r][selection.end.col + 1] & RS_multiMask) == RS_multi2))
+            if (((SCREEN_REND(r)[selection.end.col] & RS_multiMask) == RS_multi1)
+                && ((SCREEN_REND(r)[selection.end.col + 1] & RS_multiMask) == RS_multi2))
                 selection.end.col++;
         }
 #endif
@@ -3317,6 +4636,253 @@ selection_rotate(int x, int y)
     selection_extend_colrow(col, row, 1, 0);
 }
 
+/* Outgoing incremental (INCR) transfers, one per requestor property.  Data too big for a
+   single request is announced with an INCR property, and each time the requestor deletes
+   the property we write the next chunk into it, finishing with an empty one.  A lazy
+   selection isn't copied at all; each chunk is rendered from the screen as it's asked for,
+   until the selection is about to change and selection_send_detach() copies what's left. */
+typedef struct incr_send_struct {
+    Window win;
+    Atom prop, type;
+    unsigned char *data;        /* NULL while lazy */
+    size_t len, sent;
+    unsigned char xfree;        /* data came from Xlib; XFree() it when done */
+    row_col_t pos;              /* lazy:  where the next chunk starts, row relative to selection.text_beg */
+    timerhdl_t timer;           /* goes off if the requestor leaves a chunk sitting too long */
+    struct incr_send_struct *next;
+} incr_send_t;
+
+static incr_send_t *incr_sends = NULL;
+
+/* Forget a finished (or abandoned) transfer, freeing its copy of the data.  gone means the
+   requestor's window has been destroyed, so there's no event mask left to reset. */
+static void
+selection_send_free(incr_send_t *incr, unsigned char gone)
+{
+    incr_send_t **p, *q;
+    unsigned char watched = 0;
+
+    for (p = &incr_sends; *p; p = &((*p)->next)) {
+        if (*p == incr) {
+            *p = incr->next;
+            break;
+        }
+    }
+    for (q = incr_sends; q; q = q->next) {
+        if (q->win == incr->win) {
+            watched = 1;
+        }
+    }
+    if (!watched && !gone) {
+        XSelectInput(Xdisplay, incr->win, NoEventMask);
+    }
+    if (incr->timer) {
+        timer_del(incr->timer);
+    }
+    if (incr->xfree) {
+        XFree(incr->data);
+    } else if (incr->data) {
+        FREE(incr->data);
+    }
+    FREE(incr);
+}
+
+/* Drop a transfer whose requestor hasn't taken a chunk in INCR_TIMEOUT seconds. */
+static unsigned char
+selection_send_timeout(void *data)
+{
+    incr_send_t *incr = (incr_send_t *) data;
+
+    D_SELECT(("Abandoning incremental transfer to 0x%08x after %lu of %lu bytes\n", (int) incr->win,
+              (unsigned long) incr->sent, (unsigned long) incr->len));
+    incr->timer = NULL;         /* timer_check() deletes it when we return 0 */
+    selection_send_free(incr, 0);
+    return 0;
+}
+
+/* The most selection data we put in one property, keeping well inside the request limit. */
+static size_t
+selection_send_chunk(void)
+{
+    static size_t chunk = 0;
+
+    if (!chunk) {
+        chunk = MIN(INCR_CHUNK_SIZE, XMaxRequestSize(Xdisplay) * 4 - 256);
+    }
+    return chunk;
+}
+
+/* Who owns the data handed to selection_send_data(). */
+#define SEND_BORROWED       0   /* the caller; it's copied if it has to outlive the call */
+#define SEND_XFREE          1   /* Xlib; XFree() it when done */
+#define SEND_FREE           2   /* nobody else; FREE() it when done */
+
+/* Start an INCR transfer of len bytes of type to the requestor.  The caller fills in the data. */
+static incr_send_t *
+selection_send_start(XSelectionRequestEvent * rq, Atom type, size_t len)
+{
+    incr_send_t *incr;
+    long size;
+
+    /* Drop any earlier transfer to this property. */
+    for (incr = incr_sends; incr; incr = incr->next) {
+        if (incr->win == rq->requestor && incr->prop == rq->property) {
+            D_SELECT(("Abandoning incremental transfer to 0x%08x after %lu of %lu bytes\n", (int) incr->win,
+                      (unsigned long) incr->sent, (unsigned long) incr->len));
+            selection_send_free(incr, 0);
+            break;
+        }
+    }
+
+    incr = (incr_send_t *) MALLOC(sizeof(incr_send_t));
+    incr->win = rq->requestor;
+    incr->prop = rq->property;
+    incr->type = type;
+    incr->data = NULL;
+    incr->len = len;
+    incr->sent = 0;
+    incr->xfree = 0;
+    incr->timer = timer_add(INCR_TIMEOUT * 1000, selection_send_timeout, incr);
+    incr->next = incr_sends;
+    incr_sends = incr;
+
+    D_SELECT(("Starting incremental transfer of %lu bytes to 0x%08x in %lu-byte chunks\n", (unsigned long) len,
+              (int) rq->requestor, (unsigned long) selection_send_chunk()));
+    size = (long) len;
+    XSelectInput(Xdisplay, rq->requestor, PropertyChangeMask | StructureNotifyMask);
+    XChangeProperty(Xdisplay, rq->requestor, rq->property, props[PROP_SELECTION_INCR], 32, PropModeReplace,
+                    (unsigned char *) &size, 1);
+    return incr;
+}
+
+/* Put selection data in the requestor's property, starting an INCR transfer if it's too big
+   for one request.  Borrowed data is copied for a transfer, since the selection may change
+   before the requestor has it all. */
+static void
+selection_send_data(XSelectionRequestEvent * rq, Atom type, unsigned char *data, size_t len, unsigned char owner)
+{
+    incr_send_t *incr;
+
+    if (len <= selection_send_chunk()) {
+        XChangeProperty(Xdisplay, rq->requestor, rq->property, type, 8, PropModeReplace, data, len);
+        if (owner == SEND_XFREE) {
+            XFree(data);
+        } else if (owner == SEND_FREE) {
+            FREE(data);
+        }
+        return;
+    }
+    incr = selection_send_start(rq, type, len);
+    if (owner == SEND_BORROWED) {
+        incr->data = (unsigned char *) MALLOC(len);
+        memcpy(incr->data, data, len);
+    } else {
+        incr->data = data;
+    }
+    incr->xfree = (owner == SEND_XFREE);
+}
+
+/* Send the lazy selection as a string, rendering it a chunk at a time if it's too big for one
+   request. */
+static void
+selection_send_lazy(XSelectionRequestEvent * rq)
+{
+    incr_send_t *incr;
+    unsigned char *text;
+    size_t len;
+
+    len = selection_render(selection.text_beg, selection.text_end, NULL, (size_t) -1, NULL);
+    if (len <= selection_send_chunk()) {
+        text = (unsigned char *) MALLOC(len + 1);
+        selection_render(selection.text_beg, selection.text_end, text, len, NULL);
+        selection_send_data(rq, XA_STRING, text, len, SEND_FREE);
+        return;
+    }
+    incr = selection_send_start(rq, XA_STRING, len);
+    incr->pos.row = 0;
+    incr->pos.col = selection.text_beg.col;
+}
+
+/* The lazy selection is about to change or go away; give each transfer still rendering from
+   it its own copy of what it hasn't sent yet. */
+static void
+selection_send_detach(void)
+{
+    incr_send_t *incr;
+    row_col_t beg;
+
+    for (incr = incr_sends; incr; incr = incr->next) {
+        if (incr->data) {
+            continue;
+        }
+        beg.row = selection.text_beg.row + incr->pos.row;
+        beg.col = incr->pos.col;
+        incr->len -= incr->sent;
+        incr->sent = 0;
+        incr->data = (unsigned char *) MALLOC(incr->len + 1);
+        selection_render(beg, selection.text_end, incr->data, incr->len, NULL);
+        D_SELECT(("Copied the last %lu bytes of the selection for 0x%08x\n", (unsigned long) incr->len, (int) incr->win));
+    }
+}
+
+/* The requestor deleted a property; if it's one we're filling, send the next chunk. */
+void
+selection_send_incr(Window win, Atom prop)
+{
+    incr_send_t *incr;
+    size_t n;
+
+    for (incr = incr_sends; incr; incr = incr->next) {
+        if (incr->win == win && incr->prop == prop) {
+            break;
+        }
+    }
+    if (!incr) {
+        return;
+    }
+    n = MIN(incr->len - incr->sent, selection_send_chunk());
+    D_SELECT(("Sending %lu bytes (%lu of %lu sent) to 0x%08x\n", (unsigned long) n, (unsigned long) incr->sent,
+              (unsigned long) incr->len, (int) win));
+    if (incr->data) {
+        XChangeProperty(Xdisplay, win, prop, incr->type, 8, PropModeReplace, incr->data + incr->sent, n);
+    } else {
+        static unsigned char *chunk = NULL;
+        row_col_t beg;
+
+        if (!chunk) {
+            chunk = (unsigned char *) MALLOC(selection_send_chunk());
+        }
+        beg.row = selection.text_beg.row + incr->pos.row;
+        beg.col = incr->pos.col;
+        n = selection_render(beg, selection.text_end, chunk, n, &(incr->pos));
+        incr->pos.row -= selection.text_beg.row;
+        XChangeProperty(Xdisplay, win, prop, incr->type, 8, PropModeReplace, chunk, n);
+    }
+    if (!n) {
+        /* That was the empty chunk that ends the transfer. */
+        selection_send_free(incr, 0);
+        return;
+    }
+    incr->sent += n;
+    timer_change_delay(incr->timer, INCR_TIMEOUT * 1000);
+}
+
+/* A window was destroyed; drop any transfers to it. */
+void
+selection_send_destroyed(Window win)
+{
+    incr_send_t *incr, *next;
+
+    for (incr = incr_sends; incr; incr = next) {
+        next = incr->next;
+        if (incr->win == win) {
+            D_SELECT(("Requestor 0x%08x went away after %lu of %lu bytes\n", (int) win, (unsigned long) incr->sent,
+                      (unsigned long) incr->len));
+            selection_send_free(incr, 1);
+        }
+    }
+}
+
 /*
  * Respond to a request for our current selection
  * EXT: SelectionRequest
@@ -3347,37 +4913,47 @@ selection_send(XSelectionRequestEvent * rq)
     } else if (rq->target == props[PROP_UTF8_STRING]) {
         XTextProperty xtextp;
         char *l[1];
+        unsigned char *text;
+        size_t len;
 
-        *l = selection.text;
+        *l = (char *) (text = selection_text(&len));
         xtextp.value = NULL;
         xtextp.nitems = 0;
         if (XmbTextListToTextProperty(Xdisplay, l, 1, XUTF8StringStyle, &xtextp) == Success) {
             if (xtextp.nitems > 0 && xtextp.value) {
-                XChangeProperty(Xdisplay, rq->requestor, rq->property,
-                                rq->target, 8, PropModeReplace, xtextp.value, xtextp.nitems);
+                selection_send_data(rq, rq->target, xtextp.value, xtextp.nitems, SEND_XFREE);
                 ev.xselection.property = rq->property;
-                XFree(xtextp.value);
             }
         }
+        selection_text_done(text);
 #  endif /* X_HAVE_UTF8_STRING */
     } else if (rq->target == props[PROP_TEXT] || rq->target == props[PROP_COMPOUND_TEXT]) {
         XTextProperty xtextp;
         char *l[1];
+        unsigned char *text;
+        size_t len;
 
-        *l = selection.text;
+        *l = (char *) (text = selection_text(&len));
         xtextp.value = NULL;
         xtextp.nitems = 0;
         if (XmbTextListToTextProperty(Xdisplay, l, 1, XCompoundTextStyle, &xtextp) == Success) {
             if (xtextp.nitems > 0 && xtextp.value) {
-                XChangeProperty(Xdisplay, rq->requestor, rq->property, props[PROP_COMPOUND_TEXT],
-                                8, PropModeReplace, xtextp.value, xtextp.nitems);
+                selection_send_data(rq, props[PROP_COMPOUND_TEXT], xtextp.value, xtextp.nitems, SEND_XFREE);
                 ev.xselection.property = rq->property;
-                XFree(xtextp.value);
             }
         }
+        selection_text_done(text);
 #endif /* MULTI_CHARSET */
     } else {
-        XChangeProperty(Xdisplay, rq->requestor, rq->property, XA_STRING, 8, PropModeReplace, selection.text, selection.len);
+        unsigned char *text;
+        size_t len;
+
+        if (selection.lazy) {
+            selection_send_lazy(rq);
+        } else {
+            text = selection_text(&len);
+            selection_send_data(rq, XA_STRING, text, len, SEND_BORROWED);
+        }
         ev.xselection.property = rq->property;
     }
     XSendEvent(Xdisplay, rq->requestor, False, 0, &ev);
@@ -3499,7 +5075,7 @@ void
 parse_screen_status_if_necessary(void)
 {
     ns_parse_screen(TermWin.screen, (TermWin.screen_pending > 1),
-                    TERM_WINDOW_GET_REPORTED_COLS(), screen.text[TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines - 1]);
+                    TERM_WINDOW_GET_REPORTED_COLS(), SCREEN_TEXT(TERM_WINDOW_GET_REPORTED_ROWS() + TermWin.saveLines - 1));
     if (TermWin.screen_pending > 1)
         TermWin.screen_pending = 0;
 }
@@ -19,6 +19,9 @@
 /************ Macros and Definitions ************/
 #define WRAP_CHAR       (0xff)
 #define PROP_SIZE           4096
+#define INCR_CHUNK_SIZE     (64 * 1024)         /* most selection data sent in one property */
+#define INCR_TIMEOUT        30                  /* seconds before a stalled INCR send is dropped */
+#define PASTE_BACKLOG       (1024 * 1024)       /* queued paste bytes before INCR receipt waits */
 #define TABSIZE             8   /* default tab size */
 
 #define IS_SELECTION(a)         (((a) == XA_PRIMARY) || ((a) == XA_SECONDARY) || ((a) == props[PROP_CLIPBOARD]))
@@ -38,6 +41,11 @@
 
 #define scr_touch()  (refresh_all = 1)
 
+/* Buffer row -> scrollback ring slot.  See the screen_t comments below. */
+#define SCREEN_SLOT(r)  (((r) + screen.head) % screen.slots)
+#define SCREEN_TEXT(r)  (screen.text[SCREEN_SLOT(r)])
+#define SCREEN_REND(r)  (screen.rend[SCREEN_SLOT(r)])
+
 /*
  * CLEAR_ROWS : clear <num> rows starting from row <row>
  * CLEAR_CHARS: clear <num> chars starting from pixel position <x,y>
@@ -51,8 +59,7 @@
 #define CLEAR_RECT(x, y, w, h) ((buffer_pixmap) \
                                ? (XCopyArea(Xdisplay, pmap, buffer_pixmap, TermWin.gc, x, y, w, h, x, y)) \
                                : (XClearArea(Xdisplay, TermWin.vt, x, y, w, h, 0)))
-#define UPDATE_BOX(x1, y1, x2, y2)  do {if (buffer_pixmap) {if (x1 < low_x) low_x = x1; if (x2 > high_x) high_x = x2; \
-                                                            if (y1 < low_y) low_y = y1; if (y2 > high_y) high_y = y2;}} while (0)
+#define UPDATE_BOX(x1, y1, x2, y2)  do {if (buffer_pixmap) {scr_damage((x1), (y1), (x2), (y2));}} while (0)
 #define ERASE_ROWS(row, num)  do {XFillRectangle(Xdisplay, draw_buffer, TermWin.gc, Col2Pixel(0), Row2Pixel(row), TERM_WINDOW_GET_WIDTH(), Height2Pixel(num)); \
                                   if (buffer_pixmap) {XClearArea(Xdisplay, TermWin.vt, Col2Pixel(0), Row2Pixel(row), TERM_WINDOW_GET_WIDTH(), Height2Pixel(num), 0);}} while (0)
 #if FIXME_BLOCK
@@ -168,20 +175,22 @@ typedef enum {
     LATIN1 = 0, UCS2, EUCJ, EUCKR = EUCJ, GB = EUCJ, SJIS, BIG5
 } encoding_t;
 typedef struct {
-    short row, col;
+    int row, col;
 } row_col_t;
 /* screen_t:
 
    screen.text contains a 2-D array of the screen data.  screen.rend contains
    a matching 2-D array of rendering information (as 32-bit masks).  They are
-   allocated together, so you can always be sure that screen.rend[r] will be
-   allocated if screen.text[r] is.  You are also guaranteed that each row of
-   screen.text is TermWin.ncol + 1 columns long, and each row of screen.rend
-   is TermWin.ncol columns long.  They both have (TermWin.nrow +
+   allocated together (as one cell of the row arena in screen.c), so you can
+   always be sure that screen.rend[r] will be allocated if screen.text[r] is.
+   You are also guaranteed that each row of screen.text is TermWin.ncol + 1
+   columns long, and each row of screen.rend is TermWin.ncol columns long.  They both have (TermWin.nrow +
    TermWin.saveLines) rows, but only TermWin.nrow + TermWin.nscrolled lines
    are actually allocated.  The extra column in the text array is for storing
    line wrap information.  It will either be the length of the line, or 
-   WRAP_CHAR if the line wraps into the next line.
+   WRAP_CHAR if the line wraps into the next line.  Scrollback rows more than
+   TermWin.coldLines back may be packed away, in which case both pointers are
+   NULL until scr_thaw_rows() unpacks them.
 
    screen.row and screen.col contain the current cursor position.  It is always
    somewhere on the visible screen.  screen.tscroll and screen.bscroll are the
@@ -195,6 +204,7 @@ typedef struct {
     short tscroll, bscroll;
     unsigned char charset:2;
     unsigned char flags:5;
+    int head, slots;
 } screen_t;
 /* A save_t object is used to save/restore the cursor position and other
    relevant data when requested to do so by the application. */
@@ -208,6 +218,9 @@ typedef struct {
 
    selection.text is a string containing the current selection text.  It is
    duplicated from the screen data.  selection.len is the length of that string.
+   A fresh selection isn't duplicated right away, though:  while selection.lazy
+   is set, the text is still on the screen between text_beg and text_end and is
+   only rendered when someone asks for it, or saved just before those rows change.
    selection.op represents the current state, selection-wise.  selection.screen
    gives the number (0 or 1) of the current screen.  selection.clicks tells how
    many clicks created the current selection (0-3, or 4 if nothing is selected).
@@ -224,11 +237,14 @@ typedef struct {
     unsigned short screen:1;
     unsigned char clicks:3;
     row_col_t beg, mark, end;
+    row_col_t text_beg, text_end;
+    unsigned char lazy;
 } selection_t;
 
 /************ Variables ************/
 extern unsigned int colorfgbg;
 extern unsigned char refresh_all;
+extern unsigned int scroll_blits_pending;
 #ifdef MULTI_CHARSET
 extern encoding_t encoding_method;
 #endif
@@ -280,13 +296,18 @@ extern int scr_page(int, int);
 extern void scr_bell(void);
 extern void scr_printscreen(int);
 extern void scr_refresh(int);
+extern void scr_thaw_rows(int, int);
+extern void scr_rend_changed(int, int);
 extern int scr_strmatch(unsigned long, unsigned long, const char *);
 extern void scr_search_scrollback(char *);
 extern void scr_dump(void);
 extern void scr_dump_to_file(const char *);
 extern void selection_check(void);
 extern void selection_write(unsigned char *, size_t);
+extern void selection_write_end(void);
 extern void selection_fetch(Window, unsigned, int);
+extern void selection_fetch_incr(Window, unsigned);
+extern void selection_fetch_resume(void);
 extern void selection_copy_string(Atom, char *, size_t);
 extern void selection_copy(Atom);
 extern void selection_paste(Atom);
@@ -302,6 +323,8 @@ extern void selection_extend(int, int, int);
 extern void selection_extend_colrow(int, int, int, int);
 extern void selection_rotate(int, int);
 extern void selection_send(XSelectionRequestEvent *);
+extern void selection_send_incr(Window, Atom);
+extern void selection_send_destroyed(Window);
 extern void mouse_report(XButtonEvent *);
 extern void twin_mouse_drag_report(XButtonEvent *);
 extern void mouse_tracking(int, int, int, int, int);
@@ -219,7 +219,7 @@ script_handler_exit(spif_charptr_t *params)
             FREE(tmp);
         }
     }
-    exit(code);
+    normal_exit(code);
 }
 
 /* kill():  Send a given signal to Eterm's child process
@@ -347,7 +347,7 @@ sb_handle_motion_notify(event_t *ev)
         XQueryPointer(Xdisplay, scrollbar.win, &unused_root, &unused_child, &unused_root_x, &unused_root_y, &(ev->xbutton.x),
                       &(ev->xbutton.y), &unused_mask);
         scr_move_to(scrollbar_position(ev->xbutton.y) - button_state.mouse_offset, scrollbar_scrollarea_height());
-        refresh_count = refresh_limit = 0;
+        refresh_count = 0;
         scr_refresh(refresh_type);
         scrollbar_anchor_update_position(button_state.mouse_offset);
     }
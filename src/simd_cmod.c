@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 1997-2009, Michael Jennings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of the Software, its documentation and marketing & publicity
+ * materials, and acknowledgment shall be given in the documentation, materials
+ * and software packages that this Software was used.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * SSE2 and AVX2 versions of the shade_ximage_*() color modifiers in cmod.c.
+ * Each function carries its own target attribute, so this file is built with
+ * the ordinary CFLAGS and pixmap.c picks a set at runtime based on what the
+ * CPU reports.  The results are bit-for-bit those of the C routines.
+ *
+ * Every channel value c is widened to 16 bits and multiplied by its modifier
+ * m (0 - 65535, since colormod_trans() passes unsigned shorts).  The 32-bit
+ * product splits into mulhi/mullo halves, and
+ *
+ *      (c * m) >> 8  ==  (hi << 8) | (lo >> 8)
+ *
+ * For 8-bit channels the result saturates exactly when hi is non-zero.  For
+ * 5- and 6-bit channels hi is at most 62, so the shifted value stays positive
+ * and a signed min against the channel maximum does the clamping.  Without
+ * saturation (all modifiers < 256) this reduces to the C "no saturation" loop.
+ *
+ * Pixels left over at the end of a row are handled one at a time.
+ */
+
+static const char cvs_ident[] = "$Id$";
+
+#include "config.h"
+
+#ifdef HAVE_CPU_DISPATCH
+
+#include <immintrin.h>
+
+#include "cmod.h"
+
+#define SHADE_TARGET_SSE2  __attribute__ ((target("sse2")))
+#define SHADE_TARGET_AVX2  __attribute__ ((target("avx2")))
+
+/* (c * m) >> 8 for one channel, clamped to max */
+static inline int
+shade_channel(int c, int m, int max)
+{
+    c = (c * m) >> 8;
+    return ((c > max) ? max : c);
+}
+
+static void
+shade_tail_15(unsigned short *p, int n, int rm, int gm, int bm)
+{
+    for (; n > 0; n--, p++) {
+        int c = *p;
+
+        *p = (shade_channel((c >> 10) & 0x1f, rm, 0x1f) << 10)
+            | (shade_channel((c >> 5) & 0x1f, gm, 0x1f) << 5)
+            | shade_channel(c & 0x1f, bm, 0x1f);
+    }
+}
+
+static void
+shade_tail_16(unsigned short *p, int n, int rm, int gm, int bm)
+{
+    for (; n > 0; n--, p++) {
+        int c = *p;
+
+        *p = (shade_channel((c >> 11) & 0x1f, rm, 0x1f) << 11)
+            | (shade_channel((c >> 5) & 0x3f, gm, 0x3f) << 5)
+            | shade_channel(c & 0x1f, bm, 0x1f);
+    }
+}
+
+static void
+shade_tail_32(unsigned char *p, int n, int rm, int gm, int bm)
+{
+    for (; n > 0; n--, p += 4) {
+        p[2] = shade_channel(p[2], rm, 0xff);
+        p[1] = shade_channel(p[1], gm, 0xff);
+        p[0] = shade_channel(p[0], bm, 0xff);
+    }
+}
+
+/* 16-bit lanes:  (c * m) >> 8 with no clamping. */
+#define MUL_SHIFT_128(c, m)  _mm_or_si128(_mm_slli_epi16(_mm_mulhi_epu16((c), (m)), 8), \
+                                          _mm_srli_epi16(_mm_mullo_epi16((c), (m)), 8))
+#define MUL_SHIFT_256(c, m)  _mm256_or_si256(_mm256_slli_epi16(_mm256_mulhi_epu16((c), (m)), 8), \
+                                             _mm256_srli_epi16(_mm256_mullo_epi16((c), (m)), 8))
+
+/* 16-bit lanes holding 8-bit channels:  (c * m) >> 8, saturated to 0xff. */
+#define MUL_SAT8_128(c, m)   _mm_or_si128(_mm_srli_epi16(_mm_mullo_epi16((c), (m)), 8), \
+                                          _mm_andnot_si128(_mm_cmpeq_epi16(_mm_mulhi_epu16((c), (m)), zero), ff))
+#define MUL_SAT8_256(c, m)   _mm256_or_si256(_mm256_srli_epi16(_mm256_mullo_epi16((c), (m)), 8), \
+                                             _mm256_andnot_si256(_mm256_cmpeq_epi16(_mm256_mulhi_epu16((c), (m)), zero), ff))
+
+/* RGB 15 */
+SHADE_TARGET_SSE2 void
+shade_ximage_15_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    __m128i r_mod = _mm_set1_epi16(rm), g_mod = _mm_set1_epi16(gm), b_mod = _mm_set1_epi16(bm);
+    __m128i mask = _mm_set1_epi16(0x1f);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        unsigned short *p = (unsigned short *) ((unsigned char *) data + y * bpl);
+
+        for (x = 0; x + 8 <= w; x += 8, p += 8) {
+            __m128i px = _mm_loadu_si128((__m128i *) p);
+            __m128i r, g, b;
+
+            r = _mm_min_epi16(MUL_SHIFT_128(_mm_and_si128(_mm_srli_epi16(px, 10), mask), r_mod), mask);
+            g = _mm_min_epi16(MUL_SHIFT_128(_mm_and_si128(_mm_srli_epi16(px, 5), mask), g_mod), mask);
+            b = _mm_min_epi16(MUL_SHIFT_128(_mm_and_si128(px, mask), b_mod), mask);
+            px = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 10), _mm_slli_epi16(g, 5)), b);
+            _mm_storeu_si128((__m128i *) p, px);
+        }
+        shade_tail_15(p, w - x, rm, gm, bm);
+    }
+}
+
+/* RGB 16 */
+SHADE_TARGET_SSE2 void
+shade_ximage_16_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    __m128i r_mod = _mm_set1_epi16(rm), g_mod = _mm_set1_epi16(gm), b_mod = _mm_set1_epi16(bm);
+    __m128i mask5 = _mm_set1_epi16(0x1f), mask6 = _mm_set1_epi16(0x3f);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        unsigned short *p = (unsigned short *) ((unsigned char *) data + y * bpl);
+
+        for (x = 0; x + 8 <= w; x += 8, p += 8) {
+            __m128i px = _mm_loadu_si128((__m128i *) p);
+            __m128i r, g, b;
+
+            r = _mm_min_epi16(MUL_SHIFT_128(_mm_srli_epi16(px, 11), r_mod), mask5);
+            g = _mm_min_epi16(MUL_SHIFT_128(_mm_and_si128(_mm_srli_epi16(px, 5), mask6), g_mod), mask6);
+            b = _mm_min_epi16(MUL_SHIFT_128(_mm_and_si128(px, mask5), b_mod), mask5);
+            px = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+            _mm_storeu_si128((__m128i *) p, px);
+        }
+        shade_tail_16(p, w - x, rm, gm, bm);
+    }
+}
+
+/* RGB 32 */
+SHADE_TARGET_SSE2 void
+shade_ximage_32_sse2(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    /* Byte order b, g, r, x; the x byte is multiplied by 256, which leaves it alone. */
+    __m128i mod = _mm_set_epi16(256, rm, gm, bm, 256, rm, gm, bm);
+    __m128i zero = _mm_setzero_si128(), ff = _mm_set1_epi16(0xff);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        unsigned char *p = (unsigned char *) data + y * bpl;
+
+        for (x = 0; x + 4 <= w; x += 4, p += 16) {
+            __m128i px = _mm_loadu_si128((__m128i *) p);
+            __m128i lo, hi;
+
+            lo = MUL_SAT8_128(_mm_unpacklo_epi8(px, zero), mod);
+            hi = MUL_SAT8_128(_mm_unpackhi_epi8(px, zero), mod);
+            _mm_storeu_si128((__m128i *) p, _mm_packus_epi16(lo, hi));
+        }
+        shade_tail_32(p, w - x, rm, gm, bm);
+    }
+}
+
+/* RGB 15 */
+SHADE_TARGET_AVX2 void
+shade_ximage_15_avx2(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    __m256i r_mod = _mm256_set1_epi16(rm), g_mod = _mm256_set1_epi16(gm), b_mod = _mm256_set1_epi16(bm);
+    __m256i mask = _mm256_set1_epi16(0x1f);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        unsigned short *p = (unsigned short *) ((unsigned char *) data + y * bpl);
+
+        for (x = 0; x + 16 <= w; x += 16, p += 16) {
+            __m256i px = _mm256_loadu_si256((__m256i *) p);
+            __m256i r, g, b;
+
+            r = _mm256_min_epi16(MUL_SHIFT_256(_mm256_and_si256(_mm256_srli_epi16(px, 10), mask), r_mod), mask);
+            g = _mm256_min_epi16(MUL_SHIFT_256(_mm256_and_si256(_mm256_srli_epi16(px, 5), mask), g_mod), mask);
+            b = _mm256_min_epi16(MUL_SHIFT_256(_mm256_and_si256(px, mask), b_mod), mask);
+            px = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 10), _mm256_slli_epi16(g, 5)), b);
+            _mm256_storeu_si256((__m256i *) p, px);
+        }
+        shade_tail_15(p, w - x, rm, gm, bm);
+    }
+    _mm256_zeroupper();
+}
+
+/* RGB 16 */
+SHADE_TARGET_AVX2 void
+shade_ximage_16_avx2(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    __m256i r_mod = _mm256_set1_epi16(rm), g_mod = _mm256_set1_epi16(gm), b_mod = _mm256_set1_epi16(bm);
+    __m256i mask5 = _mm256_set1_epi16(0x1f), mask6 = _mm256_set1_epi16(0x3f);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        unsigned short *p = (unsigned short *) ((unsigned char *) data + y * bpl);
+
+        for (x = 0; x + 16 <= w; x += 16, p += 16) {
+            __m256i px = _mm256_loadu_si256((__m256i *) p);
+            __m256i r, g, b;
+
+            r = _mm256_min_epi16(MUL_SHIFT_256(_mm256_srli_epi16(px, 11), r_mod), mask5);
+            g = _mm256_min_epi16(MUL_SHIFT_256(_mm256_and_si256(_mm256_srli_epi16(px, 5), mask6), g_mod), mask6);
+            b = _mm256_min_epi16(MUL_SHIFT_256(_mm256_and_si256(px, mask5), b_mod), mask5);
+            px = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_slli_epi16(g, 5)), b);
+            _mm256_storeu_si256((__m256i *) p, px);
+        }
+        shade_tail_16(p, w - x, rm, gm, bm);
+    }
+    _mm256_zeroupper();
+}
+
+/* RGB 32 */
+SHADE_TARGET_AVX2 void
+shade_ximage_32_avx2(void *data, int bpl, int w, int h, int rm, int gm, int bm)
+{
+    /* Unpack and pack both work within 128-bit lanes, so the pixel order survives. */
+    __m256i mod = _mm256_set_epi16(256, rm, gm, bm, 256, rm, gm, bm, 256, rm, gm, bm, 256, rm, gm, bm);
+    __m256i zero = _mm256_setzero_si256(), ff = _mm256_set1_epi16(0xff);
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        unsigned char *p = (unsigned char *) data + y * bpl;
+
+        for (x = 0; x + 8 <= w; x += 8, p += 32) {
+            __m256i px = _mm256_loadu_si256((__m256i *) p);
+            __m256i lo, hi;
+
+            lo = MUL_SAT8_256(_mm256_unpacklo_epi8(px, zero), mod);
+            hi = MUL_SAT8_256(_mm256_unpackhi_epi8(px, zero), mod);
+            _mm256_storeu_si256((__m256i *) p, _mm256_packus_epi16(lo, hi));
+        }
+        shade_tail_32(p, w - x, rm, gm, bm);
+    }
+    _mm256_zeroupper();
+}
+
+#endif /* HAVE_CPU_DISPATCH */
@@ -145,6 +145,7 @@ eterm_bootstrap(int argc, char *argv[])
     props[PROP_DESKTOP] = XInternAtom(Xdisplay, "_NET_WM_DESKTOP", False);
     props[PROP_TRANS_PIXMAP] = XInternAtom(Xdisplay, "_XROOTPMAP_ID", False);
     props[PROP_TRANS_COLOR] = XInternAtom(Xdisplay, "_XROOTCOLOR_PIXEL", False);
+    props[PROP_SHADE_CACHE] = XInternAtom(Xdisplay, "_ETERM_SHADED_PIXMAPS", False);
     props[PROP_SELECTION_DEST] = XInternAtom(Xdisplay, "VT_SELECTION", False);
     props[PROP_SELECTION_INCR] = XInternAtom(Xdisplay, "INCR", False);
     props[PROP_SELECTION_TARGETS] = XInternAtom(Xdisplay, "TARGETS", False);
@@ -98,6 +98,7 @@ enum {
   PROP_DESKTOP,
   PROP_TRANS_PIXMAP,
   PROP_TRANS_COLOR,
+  PROP_SHADE_CACHE,
   PROP_SELECTION_DEST,
   PROP_SELECTION_INCR,
   PROP_SELECTION_TARGETS,
@@ -124,9 +125,10 @@ typedef struct {
   unsigned int fprop:1;		/* font is proportional */
   unsigned int focus:1;		/* window has focus */
   short ncol, nrow;		/* window size [characters] */
-  short saveLines;		/* number of lines that fit in scrollback */
-  short nscrolled;		/* number of line actually scrolled */
-  short view_start;		/* scrollback view starts here */
+  int   saveLines;		/* number of lines that fit in scrollback */
+  int   coldLines;		/* scrollback lines kept unpacked */
+  int   nscrolled;		/* number of line actually scrolled */
+  int   view_start;		/* scrollback view starts here */
   Window parent, vt;		/* parent (main) and vt100 window */
   GC gc;			/* GC for drawing text */
   long mask;                    /* X Event mask for TermWin.vt */
@@ -671,7 +671,7 @@ lookup_key(XEvent * ev)
            If we're in pause mode, this is a keystroke asking us to exit.  Otherwise, return here. */
         if (paused) {
             if (keysym && len) {
-                exit(0);
+                normal_exit(0);
             }
             LK_RET();
         }
@@ -1093,70 +1093,271 @@ pclose_printer(FILE * stream)
     fflush(stream);
     return pclose(stream);
 }
+#endif /* PRINTPIPE */
+
+/* Escape sequence parser.  This follows the DEC ANSI parser state diagram:  each byte is
+   sorted into a class by vt_class[], and the current state and that class pick an action
+   and the next state out of vt_table[].  Everything the parser knows lives in vt, so a
+   sequence split across two reads just picks up where it left off the next time
+   process_escape_seq() is handed more input.  NUL is ignored everywhere except while
+   feeding the print pipe, just as it is between sequences. */
+
+enum {
+    VT_GROUND,
+    VT_ESCAPE,                  /* ESC */
+    VT_ESC_INTERMEDIATE,        /* ESC #, ESC (, etc.; waiting for the final byte */
+    VT_ESC_SKIP,                /* ESC @; the next byte is thrown away */
+    VT_ESC_G,                   /* ESC G */
+    VT_ESC_G_SKIP,              /* ESC G <x>; skipping through the next ':' */
+    VT_CSI_ENTRY,               /* ESC [ */
+    VT_CSI_PARAM,               /* ESC [ ...; reading a parameter */
+    VT_CSI_SEP,                 /* ESC [ ...; just passed a separator */
+    VT_OSC_ENTRY,               /* ESC ] */
+    VT_OSC_PARAM,               /* ESC ] <digits> */
+    VT_OSC_SELECT,              /* ESC ] <letter> */
+    VT_OSC_PALETTE,             /* ESC ] P <n>; reading rrggbb */
+    VT_OSC_STRING,              /* ESC ] <n> ; ...; ends with BEL or ST */
+    VT_OSC_STRING_ESC,
+    VT_ETERM_STRING,            /* ESC ] <letter> ...; ends with ST */
+    VT_ETERM_STRING_ESC,
+    VT_PRINT,                   /* ESC [ 5 i; everything goes to the print pipe until ESC [ 4 i */
+    VT_NSTATES
+};
+
+enum {
+    VT_C_NUL, VT_C_BEL, VT_C_BS, VT_C_TAB, VT_C_CTRL, VT_C_ESC, VT_C_DIGIT, VT_C_SEMI, VT_C_MINUS,
+    VT_C_PRIV, VT_C_SEP, VT_C_BSLASH, VT_C_OTHER, VT_NCLASSES
+};
+
+enum {
+    VT_A_NONE,
+    VT_A_ESC_DISPATCH,
+    VT_A_ESC_INTERMEDIATE,
+    VT_A_ESC_G,
+    VT_A_ESC_G_SKIP,
+    VT_A_CSI_PRIV,
+    VT_A_CSI_PARAM,
+    VT_A_CSI_SEP,
+    VT_A_CSI_BS,
+    VT_A_CSI_MINUS,
+    VT_A_CSI_NPC,
+    VT_A_CSI_FINAL,
+    VT_A_CSI_DISPATCH,
+    VT_A_OSC_PARAM,
+    VT_A_OSC_NAME,
+    VT_A_OSC_SELECT,
+    VT_A_OSC_PALETTE,
+    VT_A_OSC_PUT,
+    VT_A_OSC_DISPATCH,
+    VT_A_ETERM_DISPATCH,
+    VT_A_PRINT
+};
+
+#define VT_ENTRY(a, s)          ((unsigned short) ((VT_A_ ## a) << 5 | (VT_ ## s)))
+#define VT_ENTRY_ACTION(e)      ((e) >> 5)
+#define VT_ENTRY_STATE(e)       ((e) & 0x1f)
+
+#define N_ VT_C_NUL
+#define B_ VT_C_BEL
+#define H_ VT_C_BS
+#define T_ VT_C_TAB
+#define C_ VT_C_CTRL
+#define E_ VT_C_ESC
+#define D_ VT_C_DIGIT
+#define S_ VT_C_SEMI
+#define M_ VT_C_MINUS
+#define P_ VT_C_PRIV
+#define I_ VT_C_SEP
+#define K_ VT_C_BSLASH
+#define O_ VT_C_OTHER
+#define O16_ O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_
+static const unsigned char vt_class[256] = {
+    N_, C_, C_, C_, C_, C_, C_, B_, H_, T_, C_, C_, C_, C_, C_, C_,
+    C_, C_, C_, C_, C_, C_, C_, C_, C_, C_, C_, E_, C_, C_, C_, C_,
+    I_, I_, I_, I_, I_, I_, I_, I_, I_, I_, I_, I_, I_, M_, I_, I_,
+    D_, D_, D_, D_, D_, D_, D_, D_, D_, D_, I_, S_, P_, P_, P_, P_,
+    O16_,
+    O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, O_, K_, O_, O_, O_,
+    O16_, O16_, O16_, O16_, O16_, O16_, O16_, O16_, O16_, O16_
+};
+#undef N_
+#undef B_
+#undef H_
+#undef T_
+#undef C_
+#undef E_
+#undef D_
+#undef S_
+#undef M_
+#undef P_
+#undef I_
+#undef K_
+#undef O_
+#undef O16_
+
+/* Columns:  NUL, BEL, BS, TAB, other controls, ESC, digits, ';', '-', private markers ('<' through '?'),
+   other separators (' ' through '/' and ':'), '\\', and everything else. */
+static const unsigned short vt_table[VT_NSTATES][VT_NCLASSES] = {
+    /* VT_GROUND:  only ESC gets here from main_loop(). */
+    {VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, ESCAPE), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND)},
+    /* VT_ESCAPE */
+    {VT_ENTRY(NONE, ESCAPE), VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND),
+     VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND),
+     VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND),
+     VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND), VT_ENTRY(ESC_DISPATCH, GROUND),
+     VT_ENTRY(ESC_DISPATCH, GROUND)},
+    /* VT_ESC_INTERMEDIATE */
+    {VT_ENTRY(NONE, ESC_INTERMEDIATE), VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND),
+     VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND),
+     VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND),
+     VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND), VT_ENTRY(ESC_INTERMEDIATE, GROUND),
+     VT_ENTRY(ESC_INTERMEDIATE, GROUND)},
+    /* VT_ESC_SKIP */
+    {VT_ENTRY(NONE, ESC_SKIP), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND)},
+    /* VT_ESC_G */
+    {VT_ENTRY(NONE, ESC_G), VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND),
+     VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND),
+     VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND), VT_ENTRY(ESC_G, GROUND),
+     VT_ENTRY(ESC_G, GROUND)},
+    /* VT_ESC_G_SKIP */
+    {VT_ENTRY(NONE, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP),
+     VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP),
+     VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP),
+     VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP), VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP),
+     VT_ENTRY(ESC_G_SKIP, ESC_G_SKIP)},
+    /* VT_CSI_ENTRY */
+    {VT_ENTRY(NONE, CSI_ENTRY), VT_ENTRY(CSI_NPC, GROUND), VT_ENTRY(CSI_BS, CSI_SEP), VT_ENTRY(CSI_NPC, GROUND),
+     VT_ENTRY(CSI_NPC, GROUND), VT_ENTRY(NONE, ESCAPE), VT_ENTRY(CSI_PARAM, CSI_PARAM), VT_ENTRY(CSI_SEP, CSI_SEP),
+     VT_ENTRY(CSI_MINUS, CSI_SEP), VT_ENTRY(CSI_PRIV, CSI_PARAM), VT_ENTRY(CSI_SEP, CSI_SEP),
+     VT_ENTRY(CSI_FINAL, GROUND), VT_ENTRY(CSI_FINAL, GROUND)},
+    /* VT_CSI_PARAM */
+    {VT_ENTRY(NONE, CSI_PARAM), VT_ENTRY(CSI_NPC, GROUND), VT_ENTRY(CSI_BS, CSI_SEP), VT_ENTRY(CSI_NPC, GROUND),
+     VT_ENTRY(CSI_NPC, GROUND), VT_ENTRY(NONE, ESCAPE), VT_ENTRY(CSI_PARAM, CSI_PARAM), VT_ENTRY(CSI_SEP, CSI_SEP),
+     VT_ENTRY(CSI_MINUS, CSI_SEP), VT_ENTRY(CSI_SEP, CSI_SEP), VT_ENTRY(CSI_SEP, CSI_SEP),
+     VT_ENTRY(CSI_FINAL, GROUND), VT_ENTRY(CSI_FINAL, GROUND)},
+    /* VT_CSI_SEP */
+    {VT_ENTRY(NONE, CSI_SEP), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, ESCAPE), VT_ENTRY(CSI_PARAM, CSI_PARAM), VT_ENTRY(CSI_SEP, CSI_SEP),
+     VT_ENTRY(CSI_MINUS, CSI_SEP), VT_ENTRY(CSI_SEP, CSI_SEP), VT_ENTRY(CSI_SEP, CSI_SEP),
+     VT_ENTRY(CSI_DISPATCH, GROUND), VT_ENTRY(CSI_DISPATCH, GROUND)},
+    /* VT_OSC_ENTRY */
+    {VT_ENTRY(NONE, OSC_ENTRY), VT_ENTRY(OSC_NAME, OSC_SELECT), VT_ENTRY(OSC_NAME, OSC_SELECT),
+     VT_ENTRY(OSC_NAME, OSC_SELECT), VT_ENTRY(OSC_NAME, OSC_SELECT), VT_ENTRY(OSC_NAME, OSC_SELECT),
+     VT_ENTRY(OSC_PARAM, OSC_PARAM), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_NAME, OSC_SELECT),
+     VT_ENTRY(OSC_NAME, OSC_SELECT), VT_ENTRY(OSC_NAME, OSC_SELECT), VT_ENTRY(OSC_NAME, OSC_SELECT),
+     VT_ENTRY(OSC_NAME, OSC_SELECT)},
+    /* VT_OSC_PARAM */
+    {VT_ENTRY(NONE, OSC_PARAM), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_PARAM, OSC_PARAM), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND)},
+    /* VT_OSC_SELECT */
+    {VT_ENTRY(NONE, OSC_SELECT), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND), VT_ENTRY(OSC_SELECT, GROUND),
+     VT_ENTRY(OSC_SELECT, GROUND)},
+    /* VT_OSC_PALETTE */
+    {VT_ENTRY(NONE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE),
+     VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE),
+     VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE),
+     VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE), VT_ENTRY(OSC_PALETTE, OSC_PALETTE),
+     VT_ENTRY(OSC_PALETTE, OSC_PALETTE)},
+    /* VT_OSC_STRING */
+    {VT_ENTRY(NONE, OSC_STRING), VT_ENTRY(OSC_DISPATCH, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(OSC_PUT, OSC_STRING), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, OSC_STRING_ESC),
+     VT_ENTRY(OSC_PUT, OSC_STRING), VT_ENTRY(OSC_PUT, OSC_STRING), VT_ENTRY(OSC_PUT, OSC_STRING),
+     VT_ENTRY(OSC_PUT, OSC_STRING), VT_ENTRY(OSC_PUT, OSC_STRING), VT_ENTRY(OSC_PUT, OSC_STRING),
+     VT_ENTRY(OSC_PUT, OSC_STRING)},
+    /* VT_OSC_STRING_ESC */
+    {VT_ENTRY(NONE, OSC_STRING_ESC), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(OSC_DISPATCH, GROUND),
+     VT_ENTRY(NONE, GROUND)},
+    /* VT_ETERM_STRING */
+    {VT_ENTRY(NONE, ETERM_STRING), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(OSC_PUT, ETERM_STRING), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, ETERM_STRING_ESC),
+     VT_ENTRY(OSC_PUT, ETERM_STRING), VT_ENTRY(OSC_PUT, ETERM_STRING), VT_ENTRY(OSC_PUT, ETERM_STRING),
+     VT_ENTRY(OSC_PUT, ETERM_STRING), VT_ENTRY(OSC_PUT, ETERM_STRING), VT_ENTRY(OSC_PUT, ETERM_STRING),
+     VT_ENTRY(OSC_PUT, ETERM_STRING)},
+    /* VT_ETERM_STRING_ESC */
+    {VT_ENTRY(NONE, ETERM_STRING_ESC), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND),
+     VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(NONE, GROUND), VT_ENTRY(ETERM_DISPATCH, GROUND),
+     VT_ENTRY(NONE, GROUND)},
+    /* VT_PRINT */
+    {VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT),
+     VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT),
+     VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT), VT_ENTRY(PRINT, PRINT),
+     VT_ENTRY(PRINT, PRINT)}
+};
+
+static struct {
+    unsigned char state;
+    unsigned char intermediate;         /* ESC # and the charset designators */
+    unsigned char priv;                 /* CSI private mode marker */
+    unsigned char ignore;               /* CSI sequence is read but not acted on */
+    unsigned int nargs;
+    int n;                              /* parameter being read; OSC palette index */
+    int arg[ESC_ARGS];
+    int osc;                            /* OSC number or letter */
+    unsigned long len;
+    unsigned char string[STRING_MAX];
+#ifdef PRINTPIPE
+    FILE *printer;
+    int print_index;
+#endif
+} vt;
 
+#ifdef PRINTPIPE
 /* Print everything until we hit a \e[4i sequence. */
-void
-process_print_pipe(void)
+static void
+print_pipe_put(unsigned char ch)
 {
     const char *const escape_seq = "\033[4i";
-    int index;
-    FILE *fd;
-
-    if ((fd = popen_printer())) {
-        for (index = 0; index < 4; /* nil */ ) {
-            unsigned char ch = cmd_getc();
 
-            if (ch == escape_seq[index]) {
-                index++;
-            } else if (index) {
-                int i;
+    if (ch == escape_seq[vt.print_index]) {
+        vt.print_index++;
+    } else if (vt.print_index) {
+        int i;
 
-                for (i = 0; index > 0; i++, index--) {
-                    fputc(escape_seq[i], fd);
-                }
-            }
-            if (index == 0) {
-                fputc(ch, fd);
-            }
+        for (i = 0; vt.print_index > 0; i++, vt.print_index--) {
+            fputc(escape_seq[i], vt.printer);
         }
-        pclose_printer(fd);
+    }
+    if (vt.print_index == 0) {
+        fputc(ch, vt.printer);
+    } else if (vt.print_index == 4) {
+        pclose_printer(vt.printer);
+        vt.printer = NULL;
+        vt.state = VT_GROUND;
     }
 }
 #endif /* PRINTPIPE */
 
-/* This routine processes escape sequences; i.e., when a \033 character is encountered in the
-   input stream, this function is called to process it.  First, we get the next character off
-   the input stream (the one after the ESC) and store it in ch.  Then we proceed based on what
-   ch is.  Some escape sequences are only ESC followed by a single character, so the
-   processing of those ends here.  Others are longer and get passed on to other functions from
-   this one. */
-void
-process_escape_seq(void)
+/* Act on ESC followed by <ch>.  Sequences that need more input just set the state for it. */
+static void
+esc_dispatch(unsigned char ch)
 {
-    unsigned char ch = cmd_getc();
-
     switch (ch) {
         case '#':
-            if (cmd_getc() == '8')
-                scr_E();
-            break;
         case '(':
-            scr_charset_set(0, cmd_getc());
-            break;
         case ')':
-            scr_charset_set(1, cmd_getc());
-            break;
         case '*':
-            scr_charset_set(2, cmd_getc());
-            break;
         case '+':
-            scr_charset_set(3, cmd_getc());
-            break;
 #ifdef MULTI_CHARSET
         case '$':
-            scr_charset_set(-2, cmd_getc());
-            break;
 #endif
+            vt.intermediate = ch;
+            vt.state = VT_ESC_INTERMEDIATE;
+            break;
         case '7':
             scr_cursor(SAVE);
             break;
@@ -1168,7 +1369,7 @@ process_escape_seq(void)
             PrivMode((ch == '='), PrivMode_aplKP);
             break;
         case '@':
-            (void) cmd_getc();
+            vt.state = VT_ESC_SKIP;
             break;
         case 'D':
             scr_index(UP);
@@ -1177,13 +1378,7 @@ process_escape_seq(void)
             scr_add_lines((unsigned char *) "\n\r", 1, 2);
             break;
         case 'G':
-            if ((ch = cmd_getc()) == 'Q') {     /* query graphics */
-                tt_printf((unsigned char *) "\033G0\n");        /* no graphics */
-            } else {
-                do {
-                    ch = cmd_getc();
-                } while (ch != ':');
-            }
+            vt.state = VT_ESC_G;
             break;
         case 'H':
             scr_set_tab(1);
@@ -1197,10 +1392,15 @@ process_escape_seq(void)
 #endif
             break;
         case '[':
-            process_csi_seq();
+            vt.priv = vt.ignore = 0;
+            vt.nargs = 0;
+            vt.n = 0;
+            memset(vt.arg, 0, sizeof(vt.arg));
+            vt.state = VT_CSI_ENTRY;
             break;
         case ']':
-            process_xterm_seq();
+            vt.osc = 0;
+            vt.state = VT_OSC_ENTRY;
             break;
         case 'c':
             scr_poweron();
@@ -1214,56 +1414,44 @@ process_escape_seq(void)
     }
 }
 
-/* This function handles Code Sequence Introducer (CSI) escape sequences.  At this point,
-   we've read "\e[" from the input stream.  CSI sequences take an arbitrary number of
-   parameters and are used almost exclusively for terminal window navigation and
-   manipulation. */
-void
-process_csi_seq(void)
+/* Act on ESC <intermediate> <ch>. */
+static void
+esc_intermediate_dispatch(unsigned char ch)
 {
-
-    unsigned char ch;
-    unsigned char priv = 0;
-    unsigned int nargs = 0;
-    int arg[ESC_ARGS] = { 0, 0 };
-    int ignore = 0;
-
-    ch = cmd_getc();            /* Get the next character */
-    if (ch >= '<' && ch <= '?') {
-        priv = ch;              /* DEC private mode sequence.  Get next character. */
-        ch = cmd_getc();
+    switch (vt.intermediate) {
+        case '#':
+            if (ch == '8')
+                scr_E();
+            break;
+        case '(':
+            scr_charset_set(0, ch);
+            break;
+        case ')':
+            scr_charset_set(1, ch);
+            break;
+        case '*':
+            scr_charset_set(2, ch);
+            break;
+        case '+':
+            scr_charset_set(3, ch);
+            break;
+#ifdef MULTI_CHARSET
+        case '$':
+            scr_charset_set(-2, ch);
+            break;
+#endif
     }
-    /* Read semicolon-delimited numerical arguments, if any. */
-    do {
-        int n;
-
-        for (n = 0; isdigit(ch); ch = cmd_getc())
-            n = n * 10 + (ch - '0');
-
-        if (nargs < ESC_ARGS)
-            arg[nargs++] = n;
-        if (ch == '\b') {
-            scr_backspace();
-        } else if (ch == 033) {
-            cmd_ungetc();       /* New escape sequence starting in the middle of one.  Punt. */
-            return;
-        } else if (ch < ' ') {
-            scr_add_lines(&ch, 0, 1);   /* Insert verbatim non-printable character (NPC) */
-            return;
-        }
-        if (ch == '-')          /* HACK: Ignore this sequence, but finish reading */
-            ignore = 1;         /* xterm ignores more than this, but we need this for vim */
-        if (ch < '@')
-            ch = cmd_getc();    /* Separator.  Go to next digit or operation. */
-    } while (ch >= ' ' && ch < '@');
-    if (ch == 033) {
-        cmd_ungetc();
-        return;
-    } else if (ch < ' ')
-        return;                 /* An NPC.  Punt. */
+}
 
-    if (ignore)
-        return;
+/* Act on a complete Code Sequence Introducer (CSI) escape sequence ending in <ch>.  CSI
+   sequences take an arbitrary number of parameters and are used almost exclusively for
+   terminal window navigation and manipulation. */
+static void
+csi_dispatch(unsigned char ch)
+{
+    unsigned char priv = vt.priv;
+    unsigned int nargs = vt.nargs;
+    int *arg = vt.arg;
 
     switch (ch) {
         case '@':
@@ -1372,7 +1560,10 @@ process_csi_seq(void)
                     scr_printscreen(0); /* Print screen "\e[0i" */
                     break;
                 case 5:
-                    process_print_pipe();       /* Start printing to print pipe "\e[5i" */
+                    if ((vt.printer = popen_printer())) {       /* Start printing to print pipe "\e[5i" */
+                        vt.print_index = 0;
+                        vt.state = VT_PRINT;
+                    }
                     break;
             }
             break;
@@ -1477,94 +1668,176 @@ process_csi_seq(void)
     }
 }
 
-/* process xterm text parameters sequences `ESC ] Ps ; Pt BEL' */
-void
-process_xterm_seq(void)
+/* Decide what kind of xterm text parameter sequence this is, now that we have its number or
+   letter and the byte <ch> after it.  Returns nonzero if <ch> belongs to the string and has
+   to be handled again in the new state. */
+static int
+osc_select(unsigned char ch)
 {
-    unsigned char ch, string[STRING_MAX];
-    int arg;
-
-    ch = cmd_getc();
-    if (isdigit(ch)) {
-        for (arg = 0; isdigit(ch); ch = cmd_getc()) {
-            arg = arg * 10 + (ch - '0');
-        }
-    } else if (ch == ';') {
-        arg = 0;
-    } else {
-        arg = ch;
-        ch = cmd_getc();
-    }
-    if (arg == 'R') {
+    vt.len = 0;
+    if (vt.osc == 'R') {
         stored_palette(RESTORE);
         redraw_image(image_bg);
         set_colorfgbg();
         scr_touch();
         scr_refresh(DEFAULT_REFRESH);
-        return;
-    } else if (arg == 'P') {
-        unsigned char i, idx;
-
-        idx = ((ch <= '9') ? (ch - '0') : (tolower(ch) - 'a' + 10)) + minColor;
-        string[0] = '#';
-        string[7] = 0;
-        for (i = 1; i < 7; i++) {
-            string[i] = cmd_getc();
-        }
-        set_window_color(idx, string);
-        return;
+        vt.state = VT_GROUND;
+    } else if (vt.osc == 'P') {
+        vt.n = ((ch <= '9') ? (ch - '0') : (tolower(ch) - 'a' + 10)) + minColor;
+        vt.string[vt.len++] = '#';
+        vt.state = VT_OSC_PALETTE;
     } else if (ch == ';') {
-        unsigned long n = 0;
-
-        while ((ch = cmd_getc()) != 007) {
-            if (ch) {
-                if (ch == '\t')
-                    ch = ' ';   /* translate '\t' to space */
-                else if (ch < ' ') {
-                    if (ch == 27 && (ch = cmd_getc()) == '\\')  /* ESC \ (ST) is String Terminator in Xterm */
-                        break;
-                    return;     /* control character - exit */
-                }
-                if (n < sizeof(string) - 1)
-                    string[n++] = ch;
-            }
-        }
-        string[n] = '\0';
-        xterm_seq(arg, (char *) string);
-
+        vt.state = VT_OSC_STRING;
     } else {
-        unsigned long n = 0;
+        vt.state = VT_ETERM_STRING;
+        return 1;
+    }
+    return 0;
+}
 
-        for (; ch != '\033'; ch = cmd_getc()) {
-            if (ch) {
-                if (ch == '\t')
-                    ch = ' ';   /* translate '\t' to space */
-                else if (ch < ' ')
-                    return;     /* control character - exit */
+/* Act on an Eterm-specific `ESC ] <letter> <string> ESC \' sequence. */
+static void
+eterm_dispatch(void)
+{
+    switch (vt.osc) {
+        case 'l':
+            xterm_seq(ESCSEQ_XTERM_TITLE, (char *) vt.string);
+            break;
+        case 'L':
+            xterm_seq(ESCSEQ_XTERM_ICONNAME, (char *) vt.string);
+            break;
+        case 'I':
+            set_icon_pixmap((char *) vt.string, NULL);
+            break;
+        default:
+            break;
+    }
+}
 
-                if (n < sizeof(string) - 1)
-                    string[n++] = ch;
+/* Carry out <action> for the byte <ch>.  Returns nonzero if <ch> has to be looked up again
+   in the state the action moved to. */
+static int
+vt_action(unsigned char action, unsigned char ch)
+{
+    switch (action) {
+        case VT_A_NONE:
+            break;
+        case VT_A_ESC_DISPATCH:
+            esc_dispatch(ch);
+            break;
+        case VT_A_ESC_INTERMEDIATE:
+            esc_intermediate_dispatch(ch);
+            break;
+        case VT_A_ESC_G:
+            if (ch == 'Q') {    /* query graphics */
+                tt_printf((unsigned char *) "\033G0\n");        /* no graphics */
+            } else {
+                vt.state = VT_ESC_G_SKIP;
             }
-        }
-        string[n] = '\0';
+            break;
+        case VT_A_ESC_G_SKIP:
+            if (ch == ':') {
+                vt.state = VT_GROUND;
+            }
+            break;
 
-        if ((ch = cmd_getc()) != '\\') {
-            return;
-        }
-        switch (arg) {
-            case 'l':
-                xterm_seq(ESCSEQ_XTERM_TITLE, (char *) string);
-                break;
-            case 'L':
-                xterm_seq(ESCSEQ_XTERM_ICONNAME, (char *) string);
-                break;
-            case 'I':
-                set_icon_pixmap((char *) string, NULL);
-                break;
-            default:
-                break;
+        case VT_A_CSI_PRIV:
+            vt.priv = ch;       /* DEC private mode sequence */
+            break;
+        case VT_A_CSI_PARAM:
+            vt.n = vt.n * 10 + (ch - '0');
+            break;
+        case VT_A_CSI_BS:
+        case VT_A_CSI_MINUS:
+        case VT_A_CSI_SEP:
+        case VT_A_CSI_FINAL:
+            if (vt.nargs < ESC_ARGS)
+                vt.arg[vt.nargs++] = vt.n;
+            vt.n = 0;
+            if (action == VT_A_CSI_BS) {
+                scr_backspace();
+            } else if (action == VT_A_CSI_MINUS) {
+                /* HACK: Ignore this sequence, but finish reading.  xterm ignores more than this,
+                   but we need this for vim. */
+                vt.ignore = 1;
+            } else if (action == VT_A_CSI_FINAL && !vt.ignore) {
+                csi_dispatch(ch);
+            }
+            break;
+        case VT_A_CSI_DISPATCH:
+            if (!vt.ignore) {
+                csi_dispatch(ch);
+            }
+            break;
+        case VT_A_CSI_NPC:
+            scr_add_lines(&ch, 0, 1);   /* Insert verbatim non-printable character (NPC) */
+            break;
+
+        case VT_A_OSC_PARAM:
+            vt.osc = vt.osc * 10 + (ch - '0');
+            break;
+        case VT_A_OSC_NAME:
+            vt.osc = ch;
+            break;
+        case VT_A_OSC_SELECT:
+            return osc_select(ch);
+        case VT_A_OSC_PALETTE:
+            vt.string[vt.len++] = ch;
+            if (vt.len == 7) {
+                vt.string[7] = 0;
+                set_window_color(vt.n, (char *) vt.string);
+                vt.state = VT_GROUND;
+            }
+            break;
+        case VT_A_OSC_PUT:
+            if (vt.len < sizeof(vt.string) - 1)
+                vt.string[vt.len++] = ((ch == '\t') ? ' ' : ch);      /* translate '\t' to space */
+            break;
+        case VT_A_OSC_DISPATCH:
+            vt.string[vt.len] = '\0';
+            xterm_seq(vt.osc, (char *) vt.string);
+            break;
+        case VT_A_ETERM_DISPATCH:
+            vt.string[vt.len] = '\0';
+            eterm_dispatch();
+            break;
+
+        case VT_A_PRINT:
+#ifdef PRINTPIPE
+            print_pipe_put(ch);
+#endif
+            break;
+    }
+    return 0;
+}
+
+/* Feed the bytes from <str> up to <endp> to the escape sequence parser, starting with the ESC
+   that begins a sequence or with whatever follows the part of a sequence already seen.
+   Returns a pointer just past the byte that completed the sequence, or <endp> if the
+   sequence is still not finished. */
+unsigned char *
+process_escape_seq(unsigned char *str, unsigned char *endp)
+{
+    register unsigned char *p;
+    register unsigned short entry;
+
+    for (p = str; p < endp; p++) {
+        do {
+            entry = vt_table[vt.state][vt_class[*p]];
+            vt.state = VT_ENTRY_STATE(entry);
+        } while (vt_action(VT_ENTRY_ACTION(entry), *p));
+        if (vt.state == VT_GROUND) {
+            return (p + 1);
         }
     }
+    return p;
+}
+
+/* Is the parser partway through an escape sequence? */
+int
+escape_seq_pending(void)
+{
+    return (vt.state != VT_GROUND);
 }
 
 /* Process window manipulations */
@@ -1838,6 +2111,9 @@ process_terminal_mode(int mode, int priv, unsigned int nargs, int arg[])
                         }
                         scr_change_screen(state);
                         break;
+                    case 2004: /* Bracketed paste */
+                        PrivCases(PrivMode_BracketPaste);
+                        break;
                 }
             break;
     }
@@ -177,11 +177,9 @@ extern void lookup_key(XEvent *);
 #ifdef PRINTPIPE
 extern FILE *popen_printer(void);
 extern int pclose_printer(FILE *);
-extern void process_print_pipe(void);
 #endif
-extern void process_escape_seq(void);
-extern void process_csi_seq(void);
-extern void process_xterm_seq(void);
+extern unsigned char *process_escape_seq(unsigned char *, unsigned char *);
+extern int escape_seq_pending(void);
 extern void process_window_mode(unsigned int, int []);
 extern void process_terminal_mode(int, int, unsigned int, int []);
 extern void process_sgr_mode(unsigned int, int []);
@@ -30,6 +30,7 @@ static const char cvs_ident[] = "$Id$";
 #include <unistd.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
 
 #include "startup.h"
 #include "command.h"
@@ -38,29 +39,88 @@ static const char cvs_ident[] = "$Id$";
 #include "pixmap.h"
 #include "timer.h"
 
-static etimer_t *timers = NULL;
+/* Pending timers, kept as a binary min-heap on expiry time:  heap[0] is always the next one
+   due, and each timer remembers its own slot so it can be moved or removed in O(log n). */
+static etimer_t **heap = NULL;
+static unsigned long heap_len = 0, heap_size = 0;
+
+#define TIMER_BEFORE(a, b)  (((a)->time.tv_sec < (b)->time.tv_sec) \
+                             || (((a)->time.tv_sec == (b)->time.tv_sec) && ((a)->time.tv_usec < (b)->time.tv_usec)))
+
+/* Timers run off the monotonic clock, so changing the system time doesn't make them fire
+   early or stall. */
+void
+timer_now(struct timeval *tv)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        tv->tv_sec = ts.tv_sec;
+        tv->tv_usec = ts.tv_nsec / 1000;
+        return;
+    }
+#endif
+    gettimeofday(tv, NULL);
+}
+
+static void
+timer_set_expiry(etimer_t *timer, unsigned long msec)
+{
+    timer_now(&timer->time);
+    timer->time.tv_sec += (msec / 1000);
+    timer->time.tv_usec += ((msec % 1000) * 1000);
+    if (timer->time.tv_usec >= 1000000) {
+        timer->time.tv_sec++;
+        timer->time.tv_usec -= 1000000;
+    }
+}
+
+static void
+heap_put(unsigned long i, etimer_t *timer)
+{
+    heap[i] = timer;
+    timer->index = i;
+}
+
+/* Move the timer in slot <i> toward the root or the leaves until the heap is in order again. */
+static void
+heap_fix(unsigned long i)
+{
+    etimer_t *timer = heap[i];
+    unsigned long child;
+
+    for (; i > 0 && TIMER_BEFORE(timer, heap[(i - 1) / 2]); i = (i - 1) / 2) {
+        heap_put(i, heap[(i - 1) / 2]);
+    }
+    for (; (child = 2 * i + 1) < heap_len; i = child) {
+        if (child + 1 < heap_len && TIMER_BEFORE(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!TIMER_BEFORE(heap[child], timer)) {
+            break;
+        }
+        heap_put(i, heap[child]);
+    }
+    heap_put(i, timer);
+}
 
 timerhdl_t
 timer_add(unsigned long msec, timer_handler_t handler, void *data)
 {
-    static etimer_t *timer;
-    struct timeval tv;
+    etimer_t *timer;
 
-    if (!timers) {
-        timers = (etimer_t *) MALLOC(sizeof(etimer_t));
-        timer = timers;
-        timer->next = NULL;
-    } else {
-        timer = (etimer_t *) MALLOC(sizeof(etimer_t));
-        timer->next = timers;
-        timers = timer;
+    if (heap_len == heap_size) {
+        heap_size = (heap_size ? heap_size * 2 : 8);
+        heap = (etimer_t **) REALLOC(heap, heap_size * sizeof(etimer_t *));
     }
+    timer = (etimer_t *) MALLOC(sizeof(etimer_t));
     timer->msec = msec;
-    gettimeofday(&tv, NULL);
-    timer->time.tv_sec = (msec / 1000) + tv.tv_sec;
-    timer->time.tv_usec = ((msec % 1000) * 1000) + tv.tv_usec;
+    timer_set_expiry(timer, msec);
     timer->handler = handler;
     timer->data = data;
+    heap_put(heap_len++, timer);
+    heap_fix(timer->index);
     D_TIMER(("Added timer.  Timer set to %lu/%lu with handler %8p and data %8p\n", timer->time.tv_sec, timer->time.tv_usec,
              timer->handler, timer->data));
     return ((timerhdl_t) timer);
@@ -69,56 +129,71 @@ timer_add(unsigned long msec, timer_handler_t handler, void *data)
 unsigned char
 timer_del(timerhdl_t handle)
 {
-    register etimer_t *current;
-    etimer_t *temp;
+    unsigned long i;
 
-    if (timers == handle) {
-        timers = handle->next;
-        FREE(handle);
-        return 1;
-    }
-    for (current = timers; current->next; current = current->next) {
-        if (current->next == handle) {
-            break;
-        }
-    }
-    if (!(current->next)) {
+    if (!handle || handle->index >= heap_len || heap[handle->index] != handle) {
         return 0;
     }
-    temp = current->next;
-    current->next = temp->next;
-    FREE(temp);
+    i = handle->index;
+    if (i != --heap_len) {
+        heap_put(i, heap[heap_len]);
+        heap_fix(i);
+    }
+    FREE(handle);
     return 1;
 }
 
 unsigned char
 timer_change_delay(timerhdl_t handle, unsigned long msec)
 {
-    struct timeval tv;
-
     handle->msec = msec;
-    gettimeofday(&tv, NULL);
-    handle->time.tv_sec = (msec / 1000) + tv.tv_sec;
-    handle->time.tv_usec = ((msec % 1000) * 1000) + tv.tv_usec;
+    timer_set_expiry(handle, msec);
+    heap_fix(handle->index);
     return 1;
 }
 
+/* The time to sleep before the next timer goes off, in microseconds, capped at <delay>.  A
+   negative <delay> means no cap; -1 comes back if there are no timers either. */
+long
+timer_next_delay(long delay)
+{
+    struct timeval tv;
+    long usec;
+
+    if (!heap_len) {
+        return delay;
+    }
+    timer_now(&tv);
+    usec = (heap[0]->time.tv_sec - tv.tv_sec) * 1000000L + (heap[0]->time.tv_usec - tv.tv_usec);
+    LOWER_BOUND(usec, 0);
+    if (delay < 0 || usec < delay) {
+        delay = usec;
+    }
+    return delay;
+}
+
+/* Run the handlers of all the timers which are due.  A handler returning 0 removes its
+   timer; otherwise the timer is rescheduled.  Each timer fires at most once per call, even
+   one with a delay of 0. */
 void
 timer_check(void)
 {
-    register etimer_t *current;
+    etimer_t *current;
     struct timeval tv;
+    unsigned long n;
 
-    REQUIRE(timers);
+    REQUIRE(heap_len);
 
-    gettimeofday(&tv, NULL);
-    for (current = timers; current; current = current->next) {
-        if ((current->time.tv_sec > tv.tv_sec) || ((current->time.tv_sec == tv.tv_sec) && (current->time.tv_usec >= tv.tv_usec))) {
-            if (!((current->handler) (current->data))) {
-                timer_del(current);
-            } else {
-                timer_change_delay(current, current->msec);
-            }
+    timer_now(&tv);
+    for (n = heap_len; n && heap_len; n--) {
+        current = heap[0];
+        if ((current->time.tv_sec > tv.tv_sec) || ((current->time.tv_sec == tv.tv_sec) && (current->time.tv_usec > tv.tv_usec))) {
+            break;
+        }
+        if (!((current->handler) (current->data))) {
+            timer_del(current);
+        } else {
+            timer_change_delay(current, current->msec);
         }
     }
 }
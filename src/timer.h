@@ -40,10 +40,10 @@ typedef struct timer_struct etimer_t;
 typedef etimer_t *timerhdl_t;  /* The timer handles are actually pointers to a etimer_t struct, but clients shouldn't use them as such. */
 struct timer_struct {
   unsigned long msec;
-  struct timeval time;
+  struct timeval time;		/* expiry, on the monotonic clock */
   timer_handler_t handler;
   void *data;
-  struct timer_struct *next;
+  unsigned long index;		/* slot in the heap */
 };
 
 /************ Variables ************/
@@ -51,9 +51,11 @@ struct timer_struct {
 /************ Function Prototypes ************/
 _XFUNCPROTOBEGIN
 
+extern void timer_now(struct timeval *tv);
 extern timerhdl_t timer_add(unsigned long msec, timer_handler_t handler, void *data);
 extern unsigned char timer_del(timerhdl_t handle);
 extern unsigned char timer_change_delay(timerhdl_t handle, unsigned long msec);
+extern long timer_next_delay(long delay);
 extern void timer_check(void);
 
 _XFUNCPROTOEND
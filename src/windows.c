@@ -44,6 +44,7 @@ static const char cvs_ident[] = "$Id$";
 #include "screen.h"
 #include "scrollbar.h"
 #include "term.h"
+#include "timer.h"
 #include "windows.h"
 
 XWindowAttributes attr;
@@ -687,9 +688,33 @@ handle_resize(unsigned int width, unsigned int height)
     }
 }
 
+/* While the window is being dragged, trans/viewport images are redrawn at most rs_frame_rate
+   times a second.  A move that comes in sooner is left to move_timer, which redraws for wherever
+   the window has got to by the time it goes off. */
+static struct timeval move_last_redraw;
+static timerhdl_t move_timer = NULL;
+
+static void
+move_redraw(void)
+{
+    timer_now(&move_last_redraw);
+    redraw_images_by_mode(MODE_TRANS | MODE_VIEWPORT);
+}
+
+static unsigned char
+move_timer_handler(void *data)
+{
+    USE_VAR(data);
+    move_timer = NULL;
+    move_redraw();
+    return 0;
+}
+
 void
 handle_move(int x, int y)
 {
+    struct timeval now;
+    long elapsed, interval;
     int dx, dy;
 
     if ((TermWin.x != x) || (TermWin.y != y)) {
@@ -699,9 +724,17 @@ handle_move(int x, int y)
         TermWin.y = y;
         /* If we've moved an even multiple of the screen size, there's no
            need to redraw trans/viewport images; the images will line up. */
-        if (image_mode_any(MODE_TRANS | MODE_VIEWPORT)) {
+        if (image_mode_any(MODE_TRANS | MODE_VIEWPORT) && !move_timer) {
             if ((dx % DisplayWidth(Xdisplay, Xscreen)) || (dy % DisplayHeight(Xdisplay, Xscreen))) {
-                redraw_images_by_mode(MODE_TRANS | MODE_VIEWPORT);
+                interval = (rs_frame_rate ? (long) (1000000 / rs_frame_rate) : 0);
+                timer_now(&now);
+                elapsed = (now.tv_sec - move_last_redraw.tv_sec) * 1000000 + (now.tv_usec - move_last_redraw.tv_usec);
+                if (elapsed < 0 || elapsed >= interval) {
+                    move_redraw();
+                } else {
+                    D_EVENTS(("Deferring move redraw for %ld usec.\n", interval - elapsed));
+                    move_timer = timer_add((interval - elapsed + 999) / 1000, move_timer_handler, NULL);
+                }
             }
         }
     }